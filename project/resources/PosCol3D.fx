@@ -3,6 +3,7 @@
 //-----------------
 float4x4 gWorldViewProj : WorldViewProjection;
 float4x4 gWorld : World;
+float4x4 gViewProj : ViewProjection;
 
 //-----------------
 // Textures
@@ -55,6 +56,44 @@ SamplerState samAnisotropic
     AddressV = Wrap;
 };
 
+//-----------------
+// Output Merger States
+//-----------------
+BlendState gBlendDisabled
+{
+    BlendEnable[0] = FALSE;
+};
+
+// Source over: color * alpha + target * (1 - alpha)
+BlendState gBlendAlpha
+{
+    BlendEnable[0] = TRUE;
+    SrcBlend = SRC_ALPHA;
+    DestBlend = INV_SRC_ALPHA;
+    BlendOp = ADD;
+    SrcBlendAlpha = ZERO;
+    DestBlendAlpha = ONE;
+    BlendOpAlpha = ADD;
+    RenderTargetWriteMask[0] = 0x0F;
+};
+
+DepthStencilState gDepthWrite
+{
+    DepthEnable = TRUE;
+    DepthWriteMask = ALL;
+    DepthFunc = LESS;
+    StencilEnable = FALSE;
+};
+
+// Transparent geometry is tested against the opaque depth but leaves it untouched
+DepthStencilState gDepthNoWrite
+{
+    DepthEnable = TRUE;
+    DepthWriteMask = ZERO;
+    DepthFunc = LESS;
+    StencilEnable = FALSE;
+};
+
 //-----------------
 // input/output structs
 //-----------------
@@ -67,6 +106,20 @@ struct VS_INPUT
     float3 Tangent : TANGENT;
 };
 
+struct VS_INSTANCED_INPUT
+{
+    float3 Position : POSITION;
+    float3 Color : COLOR;
+    float2 TexCoord : TEXCOORD;
+    float3 Normal : NORMAL;
+    float3 Tangent : TANGENT;
+    // Per-instance world matrix, one row per element
+    float4 InstanceWorld0 : WORLD0;
+    float4 InstanceWorld1 : WORLD1;
+    float4 InstanceWorld2 : WORLD2;
+    float4 InstanceWorld3 : WORLD3;
+};
+
 struct VS_OUTPUT
 {
     float4 Position : SV_POSITION;
@@ -90,6 +143,19 @@ VS_OUTPUT VS(VS_INPUT input)
     return output;
 }
 
+VS_OUTPUT VSInstanced(VS_INSTANCED_INPUT input)
+{
+    VS_OUTPUT output = (VS_OUTPUT) 0;
+    float4x4 instanceWorld = float4x4(input.InstanceWorld0, input.InstanceWorld1, input.InstanceWorld2, input.InstanceWorld3);
+    float4x4 world = mul(gWorld, instanceWorld);
+    output.Position = mul(mul(float4(input.Position, 1.f), world), gViewProj);
+    output.Color = input.Color;
+    output.TexCoord = input.TexCoord;
+    output.Normal = mul(normalize(input.Normal), (float3x3) world);
+    output.Tangent = mul(normalize(input.Tangent), (float3x3) world);
+    return output;
+}
+
 //-----------------
 // Pixel Shader
 //-----------------
@@ -117,6 +183,8 @@ technique11 PointTechnique
         SetVertexShader(CompileShader(vs_5_0, VS()));
         SetGeometryShader(NULL);
         SetPixelShader(CompileShader(ps_5_0, PSPoint()));
+        SetBlendState(gBlendDisabled, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthWrite, 0);
     }
 }
 technique11 LinearTechnique
@@ -126,6 +194,8 @@ technique11 LinearTechnique
         SetVertexShader(CompileShader(vs_5_0, VS()));
         SetGeometryShader(NULL);
         SetPixelShader(CompileShader(ps_5_0, PSLinear()));
+        SetBlendState(gBlendDisabled, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthWrite, 0);
     }
 }
 technique11 AnisotropicTechnique
@@ -135,6 +205,111 @@ technique11 AnisotropicTechnique
         SetVertexShader(CompileShader(vs_5_0, VS()));
         SetGeometryShader(NULL);
         SetPixelShader(CompileShader(ps_5_0, PSAnisotropic()));
+        SetBlendState(gBlendDisabled, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthWrite, 0);
+    }
+}
+
+// Instanced variants, same order as above (technique index + 3)
+technique11 PointInstancedTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSInstanced()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSPoint()));
+        SetBlendState(gBlendDisabled, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthWrite, 0);
+    }
+}
+technique11 LinearInstancedTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSInstanced()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSLinear()));
+        SetBlendState(gBlendDisabled, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthWrite, 0);
+    }
+}
+technique11 AnisotropicInstancedTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSInstanced()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSAnisotropic()));
+        SetBlendState(gBlendDisabled, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthWrite, 0);
+    }
+}
+
+// Transparent variants (technique index + 6, instanced + 9): blended, no depth write
+technique11 PointTransparentTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VS()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSPoint()));
+        SetBlendState(gBlendAlpha, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthNoWrite, 0);
+    }
+}
+technique11 LinearTransparentTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VS()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSLinear()));
+        SetBlendState(gBlendAlpha, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthNoWrite, 0);
+    }
+}
+technique11 AnisotropicTransparentTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VS()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSAnisotropic()));
+        SetBlendState(gBlendAlpha, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthNoWrite, 0);
+    }
+}
+technique11 PointTransparentInstancedTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSInstanced()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSPoint()));
+        SetBlendState(gBlendAlpha, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthNoWrite, 0);
+    }
+}
+technique11 LinearTransparentInstancedTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSInstanced()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSLinear()));
+        SetBlendState(gBlendAlpha, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthNoWrite, 0);
+    }
+}
+technique11 AnisotropicTransparentInstancedTechnique
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSInstanced()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PSAnisotropic()));
+        SetBlendState(gBlendAlpha, float4(0.0f, 0.0f, 0.0f, 0.0f), 0xFFFFFFFF);
+        SetDepthStencilState(gDepthNoWrite, 0);
     }
 }
 
@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "BlockCompression.h"
+
+namespace dae
+{
+	namespace BlockCompression
+	{
+		namespace
+		{
+			inline int Channel(uint32_t texel, int shift)
+			{
+				return static_cast<int>((texel >> shift) & 0xFF);
+			}
+
+			inline uint32_t PackTexel(int r, int g, int b, int a)
+			{
+				return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(a) << 24);
+			}
+
+			inline uint16_t To565(int r, int g, int b)
+			{
+				return static_cast<uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+			}
+
+			inline uint32_t From565(uint16_t color)
+			{
+				const int r = (color >> 11) & 0x1F;
+				const int g = (color >> 5) & 0x3F;
+				const int b = color & 0x1F;
+				return PackTexel((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255);
+			}
+
+			inline uint32_t Mix(uint32_t a, uint32_t b, int weightA, int weightB)
+			{
+				const int total = weightA + weightB;
+				return PackTexel(
+					(Channel(a, 0) * weightA + Channel(b, 0) * weightB) / total,
+					(Channel(a, 8) * weightA + Channel(b, 8) * weightB) / total,
+					(Channel(a, 16) * weightA + Channel(b, 16) * weightB) / total,
+					255);
+			}
+
+			inline int ColorDistance(uint32_t a, uint32_t b)
+			{
+				const int dr = Channel(a, 0) - Channel(b, 0);
+				const int dg = Channel(a, 8) - Channel(b, 8);
+				const int db = Channel(a, 16) - Channel(b, 16);
+				return dr * dr + dg * dg + db * db;
+			}
+
+			// 2 endpoints (565) + 2 bit indices, endpoints from the inset bounding box of the block
+			void EncodeColorBlock(const uint32_t texels[16], uint8_t* pBlock)
+			{
+				int minColor[3]{ 255, 255, 255 };
+				int maxColor[3]{ 0, 0, 0 };
+				for (int i = 0; i < 16; ++i)
+				{
+					for (int c = 0; c < 3; ++c)
+					{
+						minColor[c] = std::min(minColor[c], Channel(texels[i], c * 8));
+						maxColor[c] = std::max(maxColor[c], Channel(texels[i], c * 8));
+					}
+				}
+				for (int c = 0; c < 3; ++c)
+				{
+					const int inset = (maxColor[c] - minColor[c]) >> 4;
+					minColor[c] += inset;
+					maxColor[c] -= inset;
+				}
+
+				uint16_t color0 = To565(maxColor[0], maxColor[1], maxColor[2]);
+				uint16_t color1 = To565(minColor[0], minColor[1], minColor[2]);
+				if (color0 < color1) {
+					std::swap(color0, color1);
+				}
+
+				// color0 > color1 selects the 4 color mode
+				uint32_t indices = 0;
+				if (color0 != color1)
+				{
+					const uint32_t p0 = From565(color0);
+					const uint32_t p1 = From565(color1);
+					const uint32_t palette[4]{ p0, p1, Mix(p0, p1, 2, 1), Mix(p0, p1, 1, 2) };
+
+					for (int i = 0; i < 16; ++i)
+					{
+						int bestIndex = 0;
+						int bestDistance = ColorDistance(texels[i], palette[0]);
+						for (int p = 1; p < 4; ++p)
+						{
+							const int distance = ColorDistance(texels[i], palette[p]);
+							if (distance < bestDistance)
+							{
+								bestDistance = distance;
+								bestIndex = p;
+							}
+						}
+						indices |= static_cast<uint32_t>(bestIndex) << (2 * i);
+					}
+				}
+
+				pBlock[0] = static_cast<uint8_t>(color0 & 0xFF);
+				pBlock[1] = static_cast<uint8_t>(color0 >> 8);
+				pBlock[2] = static_cast<uint8_t>(color1 & 0xFF);
+				pBlock[3] = static_cast<uint8_t>(color1 >> 8);
+				for (int b = 0; b < 4; ++b) {
+					pBlock[4 + b] = static_cast<uint8_t>(indices >> (8 * b));
+				}
+			}
+
+			void DecodeColorBlock(const uint8_t* pBlock, uint32_t texels[16], bool allowTransparent)
+			{
+				const uint16_t color0 = static_cast<uint16_t>(pBlock[0] | (pBlock[1] << 8));
+				const uint16_t color1 = static_cast<uint16_t>(pBlock[2] | (pBlock[3] << 8));
+				const uint32_t p0 = From565(color0);
+				const uint32_t p1 = From565(color1);
+
+				uint32_t palette[4]{ p0, p1, Mix(p0, p1, 2, 1), Mix(p0, p1, 1, 2) };
+				if (allowTransparent && color0 <= color1)
+				{
+					palette[2] = Mix(p0, p1, 1, 1);
+					palette[3] = 0;
+				}
+
+				const uint32_t indices = pBlock[4] | (pBlock[5] << 8) | (pBlock[6] << 16) | (static_cast<uint32_t>(pBlock[7]) << 24);
+				for (int i = 0; i < 16; ++i) {
+					texels[i] = palette[(indices >> (2 * i)) & 0x3];
+				}
+			}
+
+			// One channel: 2 endpoints + 3 bit indices
+			void EncodeChannelBlock(const uint32_t texels[16], int shift, uint8_t* pBlock)
+			{
+				int minValue = 255;
+				int maxValue = 0;
+				for (int i = 0; i < 16; ++i)
+				{
+					minValue = std::min(minValue, Channel(texels[i], shift));
+					maxValue = std::max(maxValue, Channel(texels[i], shift));
+				}
+
+				// max > min selects the 8 value mode
+				uint64_t indices = 0;
+				if (maxValue != minValue)
+				{
+					int palette[8]{ maxValue, minValue };
+					for (int p = 1; p < 7; ++p) {
+						palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7;
+					}
+
+					for (int i = 0; i < 16; ++i)
+					{
+						const int value = Channel(texels[i], shift);
+						int bestIndex = 0;
+						int bestDistance = std::abs(value - palette[0]);
+						for (int p = 1; p < 8; ++p)
+						{
+							const int distance = std::abs(value - palette[p]);
+							if (distance < bestDistance)
+							{
+								bestDistance = distance;
+								bestIndex = p;
+							}
+						}
+						indices |= static_cast<uint64_t>(bestIndex) << (3 * i);
+					}
+				}
+
+				pBlock[0] = static_cast<uint8_t>(maxValue);
+				pBlock[1] = static_cast<uint8_t>(minValue);
+				for (int b = 0; b < 6; ++b) {
+					pBlock[2 + b] = static_cast<uint8_t>(indices >> (8 * b));
+				}
+			}
+
+			void DecodeChannelBlock(const uint8_t* pBlock, int values[16])
+			{
+				const int value0 = pBlock[0];
+				const int value1 = pBlock[1];
+
+				int palette[8]{ value0, value1 };
+				if (value0 > value1)
+				{
+					for (int p = 1; p < 7; ++p) {
+						palette[p + 1] = ((7 - p) * value0 + p * value1) / 7;
+					}
+				}
+				else
+				{
+					for (int p = 1; p < 5; ++p) {
+						palette[p + 1] = ((5 - p) * value0 + p * value1) / 5;
+					}
+					palette[6] = 0;
+					palette[7] = 255;
+				}
+
+				uint64_t indices = 0;
+				for (int b = 0; b < 6; ++b) {
+					indices |= static_cast<uint64_t>(pBlock[2 + b]) << (8 * b);
+				}
+				for (int i = 0; i < 16; ++i) {
+					values[i] = palette[(indices >> (3 * i)) & 0x7];
+				}
+			}
+		}
+
+		void EncodeBC1(const uint32_t texels[16], uint8_t* pBlock)
+		{
+			EncodeColorBlock(texels, pBlock);
+		}
+
+		void DecodeBC1(const uint8_t* pBlock, uint32_t texels[16])
+		{
+			DecodeColorBlock(pBlock, texels, true);
+		}
+
+		void EncodeBC3(const uint32_t texels[16], uint8_t* pBlock)
+		{
+			EncodeChannelBlock(texels, 24, pBlock);
+			EncodeColorBlock(texels, pBlock + 8);
+		}
+
+		void DecodeBC3(const uint8_t* pBlock, uint32_t texels[16])
+		{
+			int alpha[16];
+			DecodeChannelBlock(pBlock, alpha);
+			DecodeColorBlock(pBlock + 8, texels, false);
+
+			for (int i = 0; i < 16; ++i) {
+				texels[i] = (texels[i] & 0x00FFFFFF) | (static_cast<uint32_t>(alpha[i]) << 24);
+			}
+		}
+
+		void EncodeBC5(const uint32_t texels[16], uint8_t* pBlock)
+		{
+			EncodeChannelBlock(texels, 0, pBlock);
+			EncodeChannelBlock(texels, 8, pBlock + 8);
+		}
+
+		void DecodeBC5(const uint8_t* pBlock, uint32_t texels[16])
+		{
+			int red[16];
+			int green[16];
+			DecodeChannelBlock(pBlock, red);
+			DecodeChannelBlock(pBlock + 8, green);
+
+			for (int i = 0; i < 16; ++i)
+			{
+				// Unit length normal: z = sqrt(1 - x^2 - y^2)
+				const float x = red[i] / 127.5f - 1.f;
+				const float y = green[i] / 127.5f - 1.f;
+				const float z = std::sqrt(std::max(0.f, 1.f - x * x - y * y));
+				texels[i] = PackTexel(red[i], green[i], static_cast<int>((z * 0.5f + 0.5f) * 255.f + 0.5f), 255);
+			}
+		}
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+namespace dae
+{
+	// 4x4 block codecs, texels are RGBA8 with r in the lowest byte (row major, 16 per block)
+	namespace BlockCompression
+	{
+		constexpr int blockDimension{ 4 };
+		constexpr int bc1BlockBytes{ 8 };
+		constexpr int bc3BlockBytes{ 16 };
+		constexpr int bc5BlockBytes{ 16 };
+
+		// Opaque color, 4 bits per texel
+		void EncodeBC1(const uint32_t texels[16], uint8_t* pBlock);
+		void DecodeBC1(const uint8_t* pBlock, uint32_t texels[16]);
+
+		// Color + interpolated alpha, 8 bits per texel
+		void EncodeBC3(const uint32_t texels[16], uint8_t* pBlock);
+		void DecodeBC3(const uint8_t* pBlock, uint32_t texels[16]);
+
+		// Two channels (tangent space normal xy), z is rebuilt into blue when decoding
+		void EncodeBC5(const uint32_t texels[16], uint8_t* pBlock);
+		void DecodeBC5(const uint8_t* pBlock, uint32_t texels[16]);
+	}
+}
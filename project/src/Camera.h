@@ -77,6 +77,20 @@ namespace dae {
 				{ 0, 0, B, 0 } };
 		};
 
+		// Places the camera without input, yaw and pitch in radians like totalYaw and totalPitch
+		void SetPose(const Vector3& _origin, float yaw, float pitch)
+		{
+			origin = _origin;
+			totalYaw = yaw;
+			totalPitch = pitch;
+
+			const Matrix finalRotation{ Matrix::CreateRotationX(totalPitch) * Matrix::CreateRotationY(totalYaw) };
+			forward = finalRotation.TransformVector(Vector3::UnitZ);
+			forward.Normalize();
+
+			CalculateViewMatrix();
+		}
+
 		Matrix GetViewMatrix() const { return viewMatrix; };
 		Matrix GetProjectionMatrix()  const { return projectionMatrix; };
 
@@ -0,0 +1,52 @@
+#include "pch.h"
+#include "CameraPath.h"
+#include <fstream>
+
+namespace dae
+{
+	bool CameraPath::LoadFromFile(const std::string& path)
+	{
+		std::ifstream file{ path };
+		if (!file)
+			return false;
+
+		m_Keyframes.clear();
+		std::string line{};
+		while (std::getline(file, line))
+		{
+			const size_t comment{ line.find('#') };
+			if (comment != std::string::npos)
+				line.erase(comment);
+
+			std::istringstream stream{ line };
+			Keyframe keyframe{};
+			float yawDegrees{}, pitchDegrees{};
+			if (!(stream >> keyframe.origin.x >> keyframe.origin.y >> keyframe.origin.z >> yawDegrees >> pitchDegrees))
+				continue;
+
+			keyframe.yaw = yawDegrees * TO_RADIANS;
+			keyframe.pitch = pitchDegrees * TO_RADIANS;
+			m_Keyframes.push_back(keyframe);
+		}
+		return !m_Keyframes.empty();
+	}
+
+	CameraPath::Keyframe CameraPath::Evaluate(float t) const
+	{
+		if (m_Keyframes.size() < 2)
+			return m_Keyframes.empty() ? Keyframe{} : m_Keyframes.front();
+
+		const float position{ std::clamp(t, 0.f, 1.f) * (m_Keyframes.size() - 1) };
+		const size_t index{ std::min(static_cast<size_t>(position), m_Keyframes.size() - 2) };
+		const float weight{ position - index };
+
+		const Keyframe& from{ m_Keyframes[index] };
+		const Keyframe& to{ m_Keyframes[index + 1] };
+
+		Keyframe keyframe{};
+		keyframe.origin = from.origin + (to.origin - from.origin) * weight;
+		keyframe.yaw = from.yaw + (to.yaw - from.yaw) * weight;
+		keyframe.pitch = from.pitch + (to.pitch - from.pitch) * weight;
+		return keyframe;
+	}
+}
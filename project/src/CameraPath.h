@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	// Camera keyframes spread evenly over a run, read from a text file with one "x y z yaw pitch" per line
+	// (angles in degrees, # starts a comment). Drives the camera when there is no input, as in headless mode
+	class CameraPath final
+	{
+	public:
+		struct Keyframe
+		{
+			Vector3 origin{};
+			float yaw{};		// radians
+			float pitch{};		// radians
+		};
+
+		CameraPath() = default;
+
+		bool LoadFromFile(const std::string& path);
+
+		// t from 0 (first keyframe) to 1 (last keyframe), linear in between
+		Keyframe Evaluate(float t) const;
+		bool IsEmpty() const { return m_Keyframes.empty(); }
+
+	private:
+		std::vector<Keyframe> m_Keyframes{};
+	};
+}
@@ -14,12 +14,39 @@ Effect::Effect(ID3D11Device* pDevice, const std::wstring& assetFile) :
 		std::wcout << L"Technique not valid\n";
 	}
 
+	m_pInstancedTechnique = m_pEffect->GetTechniqueByName("PointInstancedTechnique");
+	if (!m_pInstancedTechnique) {
+		std::wcout << L"Instanced technique not valid\n";
+	}
+
+	m_pTransparentTechnique = m_pEffect->GetTechniqueByName("PointTransparentTechnique");
+	if (!m_pTransparentTechnique) {
+		std::wcout << L"Transparent technique not valid\n";
+	}
+
+	m_pTransparentInstancedTechnique = m_pEffect->GetTechniqueByName("PointTransparentInstancedTechnique");
+	if (!m_pTransparentInstancedTechnique) {
+		std::wcout << L"Transparent instanced technique not valid\n";
+	}
+
 	m_pWorldMatrixVariable = m_pEffect->GetVariableByName("gWorldViewProj")->AsMatrix();
 	if (!m_pWorldMatrixVariable->IsValid())
 	{
 		std::wcout << L"gWorldViewProj variable not valid!\n";
 	}
 
+	m_pWorldVariable = m_pEffect->GetVariableByName("gWorld")->AsMatrix();
+	if (!m_pWorldVariable->IsValid())
+	{
+		std::wcout << L"gWorld variable not valid!\n";
+	}
+
+	m_pViewProjectionVariable = m_pEffect->GetVariableByName("gViewProj")->AsMatrix();
+	if (!m_pViewProjectionVariable->IsValid())
+	{
+		std::wcout << L"gViewProj variable not valid!\n";
+	}
+
 	m_pDiffuseMapVariable = m_pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource();
 	if (!m_pDiffuseMapVariable->IsValid())
 	{
@@ -41,10 +68,35 @@ Effect::~Effect()
 		m_pTechnique = nullptr;
 	}
 
+	if (m_pInstancedTechnique) {
+
+		m_pInstancedTechnique = nullptr;
+	}
+
+	if (m_pTransparentTechnique) {
+
+		m_pTransparentTechnique = nullptr;
+	}
+
+	if (m_pTransparentInstancedTechnique) {
+
+		m_pTransparentInstancedTechnique = nullptr;
+	}
+
 	if (m_pWorldMatrixVariable)
 	{
 		m_pWorldMatrixVariable = nullptr;
 	}
+
+	if (m_pWorldVariable)
+	{
+		m_pWorldVariable = nullptr;
+	}
+
+	if (m_pViewProjectionVariable)
+	{
+		m_pViewProjectionVariable = nullptr;
+	}
 	//if (m_pInputLayout) {
 	//	m_pInputLayout->Release();
 	//	m_pInputLayout = nullptr;
@@ -111,11 +163,36 @@ ID3DX11EffectTechnique* Effect::GetTechnique() const
 	return m_pTechnique;
 }
 
+ID3DX11EffectTechnique* Effect::GetInstancedTechnique() const
+{
+	return m_pInstancedTechnique;
+}
+
+ID3DX11EffectTechnique* Effect::GetTransparentTechnique() const
+{
+	return m_pTransparentTechnique;
+}
+
+ID3DX11EffectTechnique* Effect::GetTransparentInstancedTechnique() const
+{
+	return m_pTransparentInstancedTechnique;
+}
+
 void Effect::SetMatrix(const Matrix& wvpMatrix) const
 {
 	m_pWorldMatrixVariable->SetMatrix(reinterpret_cast<const float*>(&wvpMatrix));
 }
 
+void Effect::SetWorldMatrix(const Matrix& world) const
+{
+	m_pWorldVariable->SetMatrix(reinterpret_cast<const float*>(&world));
+}
+
+void Effect::SetViewProjectionMatrix(const Matrix& viewProjection) const
+{
+	m_pViewProjectionVariable->SetMatrix(reinterpret_cast<const float*>(&viewProjection));
+}
+
 void Effect::SetDiffuseMap(Texture* texture) const
 {
 	if (texture)
@@ -124,32 +201,36 @@ void Effect::SetDiffuseMap(Texture* texture) const
 	}
 }
 
-void Effect::ToggleTechnique()
+void Effect::SetTechniqueIndex(int techniqueIdx)
 {
 	// 3 techniques in the effect file
 	// ---------------------------------
 	// 0 -> PointTechnique
 	// 1 -> LinearTechnique
 	// 2 -> AnisotropicTechnique
+	// (+3 for the instanced variant of each)
+	// (+6 transparent, +9 transparent instanced)
 
-	std::string techniqueName;
-	m_TechniqueIdx = (m_TechniqueIdx + 1) % 3;
-	if (m_TechniqueIdx == 0) {
-		techniqueName = "POINT";
-	}
-	else if (m_TechniqueIdx == 1) {
-		techniqueName = "LINEAR";
-	}
-	else {
-		techniqueName = "ANISOTROPIC";
-	}
-	std::cout << "\033[32m";
-	std::cout << "**(HARDWARE) Sampler Filter = " << techniqueName << std::endl;
-	std::cout << "\033[0m";
+	m_TechniqueIdx = techniqueIdx % 3;
 	m_pTechnique = m_pEffect->GetTechniqueByIndex(m_TechniqueIdx);
 	if (!m_pTechnique) {
 		std::wcout << L"Technique not valid\n";
 	}
+
+	m_pInstancedTechnique = m_pEffect->GetTechniqueByIndex(m_TechniqueIdx + 3);
+	if (!m_pInstancedTechnique) {
+		std::wcout << L"Instanced technique not valid\n";
+	}
+
+	m_pTransparentTechnique = m_pEffect->GetTechniqueByIndex(m_TechniqueIdx + 6);
+	if (!m_pTransparentTechnique) {
+		std::wcout << L"Transparent technique not valid\n";
+	}
+
+	m_pTransparentInstancedTechnique = m_pEffect->GetTechniqueByIndex(m_TechniqueIdx + 9);
+	if (!m_pTransparentInstancedTechnique) {
+		std::wcout << L"Transparent instanced technique not valid\n";
+	}
 }
 
 //D3D11InputLayout* Effect::GetInputLayout() const
@@ -17,19 +17,30 @@ public:
 
     // Getters
     ID3DX11EffectTechnique* GetTechnique() const;
+    ID3DX11EffectTechnique* GetInstancedTechnique() const;
+    // Alpha blended, depth tested without depth write
+    ID3DX11EffectTechnique* GetTransparentTechnique() const;
+    ID3DX11EffectTechnique* GetTransparentInstancedTechnique() const;
     //ID3D11InputLayout* GetInputLayout() const;
 
 	void SetMatrix(const Matrix& world) const;
+	void SetWorldMatrix(const Matrix& world) const;
+	void SetViewProjectionMatrix(const Matrix& viewProjection) const;
 	void SetDiffuseMap(Texture* texture) const;
 
-    void ToggleTechnique();
+    void SetTechniqueIndex(int techniqueIdx);
     
 private:
     ID3DX11Effect* m_pEffect;
     ID3DX11EffectTechnique* m_pTechnique{};
+    ID3DX11EffectTechnique* m_pInstancedTechnique{};
+    ID3DX11EffectTechnique* m_pTransparentTechnique{};
+    ID3DX11EffectTechnique* m_pTransparentInstancedTechnique{};
     ID3D11InputLayout* m_pInputLayout{};
 
     ID3DX11EffectMatrixVariable* m_pWorldMatrixVariable{};
+    ID3DX11EffectMatrixVariable* m_pWorldVariable{};
+    ID3DX11EffectMatrixVariable* m_pViewProjectionVariable{};
 	ID3DX11EffectShaderResourceVariable* m_pDiffuseMapVariable{};
 
 	int m_TechniqueIdx{ 0 };
@@ -0,0 +1,248 @@
+#include "pch.h"
+#include "FrameCapture.h"
+
+namespace dae
+{
+	FrameCapture::FrameCapture(const std::string& path, int width, int height, float frameRate, int slotCount) :
+		m_Path{ path },
+		m_Format{ GetFormat(path) },
+		m_Width{ width },
+		m_Height{ height }
+	{
+		if (m_Format == CaptureFormat::Png)
+		{
+			// Frame number goes in front of the extension when the path has no pattern of its own,
+			// the path is a printf format from here on
+			if (m_Path.find('%') == std::string::npos)
+				m_Path.insert(m_Path.size() - 4, "_%05d");
+			m_IsOpen = IsFrameNumberPattern(m_Path);
+		}
+		else
+		{
+			m_Stream.open(m_Path, std::ios::binary);
+			m_IsOpen = m_Stream.is_open();
+		}
+
+		if (!m_IsOpen)
+			return;
+
+		if (m_Format == CaptureFormat::Y4m)
+		{
+			// Frame rate as a fraction in thousandths, 4:4:4 keeps the chroma of thin edges
+			m_Stream << "YUV4MPEG2 W" << m_Width << " H" << m_Height
+				<< " F" << static_cast<int>(frameRate * 1000.f + 0.5f) << ":1000 Ip A1:1 C444\n";
+			m_Planes.resize(3 * static_cast<size_t>(m_Width) * m_Height);
+		}
+
+		m_Slots.resize(std::max(slotCount, 1));
+		for (int i = 0; i < static_cast<int>(m_Slots.size()); ++i)
+		{
+			m_Slots[i].resize(4 * static_cast<size_t>(m_Width) * m_Height);
+			m_FreeSlots.push_back(i);
+		}
+
+		m_Thread = std::thread{ [this]() { WriteLoop(); } };
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		Close();
+	}
+
+	void FrameCapture::Close()
+	{
+		// Frames already queued are still written
+		if (m_Thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock{ m_Mutex };
+				m_IsStopping = true;
+			}
+			m_FrameQueued.notify_all();
+			m_Thread.join();
+		}
+
+		if (m_Stream.is_open())
+		{
+			// Frames dropped after the last one written
+			RepeatStreamFrames(m_SubmittedFrames);
+			m_Stream.close();
+			if (m_Stream.fail())
+				++m_FailedFrames;
+		}
+		m_IsOpen = false;
+	}
+
+	bool FrameCapture::Submit(SDL_Surface* pFrame)
+	{
+		if (!m_IsOpen || pFrame->w != m_Width || pFrame->h != m_Height)
+			return false;
+
+		int slot{};
+		int frameNumber{};
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			frameNumber = m_SubmittedFrames++;
+			if (m_FreeSlots.empty())
+			{
+				++m_DroppedFrames;
+				return false;
+			}
+			slot = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		}
+
+		// Only this copy happens on the render thread, byte order RGBA whatever the surface format
+		SDL_LockSurface(pFrame);
+		SDL_ConvertPixels(m_Width, m_Height, pFrame->format->format, pFrame->pixels, pFrame->pitch,
+			SDL_PIXELFORMAT_RGBA32, m_Slots[slot].data(), m_Width * 4);
+		SDL_UnlockSurface(pFrame);
+
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_Queue.push_back({ slot, frameNumber });
+		}
+		m_FrameQueued.notify_one();
+		return true;
+	}
+
+	CaptureFormat FrameCapture::GetFormat(const std::string& path)
+	{
+		if (path.ends_with(".png"))
+			return CaptureFormat::Png;
+		if (path.ends_with(".y4m"))
+			return CaptureFormat::Y4m;
+		return CaptureFormat::RawRgba;
+	}
+
+	bool FrameCapture::IsFrameNumberPattern(const std::string& pattern)
+	{
+		int conversions{};
+		for (size_t i = 0; i < pattern.size(); ++i)
+		{
+			if (pattern[i] != '%')
+				continue;
+
+			if (++i < pattern.size() && pattern[i] == '%')
+				continue;
+
+			// Optional zero padded width of one or two digits
+			if (i < pattern.size() && pattern[i] == '0')
+			{
+				size_t digits{};
+				while (++i < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i])) && digits < 2)
+				{
+					++digits;
+				}
+				if (digits == 0)
+					return false;
+			}
+
+			if (i >= pattern.size() || pattern[i] != 'd')
+				return false;
+			++conversions;
+		}
+		return conversions == 1;
+	}
+
+	void FrameCapture::WriteLoop()
+	{
+		while (true)
+		{
+			QueuedFrame queued{};
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_FrameQueued.wait(lock, [this]() { return m_IsStopping || !m_Queue.empty(); });
+
+				if (m_Queue.empty())
+					return;
+
+				queued = m_Queue.front();
+				m_Queue.pop_front();
+			}
+
+			if (m_Format != CaptureFormat::Png)
+				RepeatStreamFrames(queued.frameNumber);
+			if (!WriteFrame(m_Slots[queued.slot], queued.frameNumber))
+				++m_FailedFrames;
+
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_FreeSlots.push_back(queued.slot);
+		}
+	}
+
+	bool FrameCapture::WriteFrame(const std::vector<uint8_t>& pixels, int frameNumber)
+	{
+		switch (m_Format)
+		{
+		case CaptureFormat::Png:
+		{
+			// Checked by IsFrameNumberPattern in the constructor
+			std::vector<char> fileName(m_Path.size() + 32);
+			std::snprintf(fileName.data(), fileName.size(), m_Path.c_str(), frameNumber);
+
+			SDL_Surface* pSurface{ SDL_CreateRGBSurfaceWithFormatFrom(const_cast<uint8_t*>(pixels.data()), m_Width, m_Height,
+				32, m_Width * 4, SDL_PIXELFORMAT_RGBA32) };
+			if (!pSurface)
+				return false;
+
+			const bool isSaved{ IMG_SavePNG(pSurface, fileName.data()) == 0 };
+			SDL_FreeSurface(pSurface);
+			return isSaved;
+		}
+		case CaptureFormat::Y4m:
+			return WriteY4mFrame(pixels);
+		case CaptureFormat::RawRgba:
+			m_LastFrame = pixels;
+			m_Stream.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+			++m_StreamFrames;
+			return m_Stream.good();
+		}
+		return false;
+	}
+
+	void FrameCapture::RepeatStreamFrames(int frameCount)
+	{
+		// Nothing to repeat before the first frame, the ring is empty then so it is never dropped
+		if (m_StreamFrames == 0)
+			return;
+
+		for (; m_StreamFrames < frameCount; ++m_StreamFrames)
+		{
+			if (m_Format == CaptureFormat::Y4m)
+			{
+				m_Stream << "FRAME\n";
+				m_Stream.write(reinterpret_cast<const char*>(m_Planes.data()), m_Planes.size());
+			}
+			else
+			{
+				m_Stream.write(reinterpret_cast<const char*>(m_LastFrame.data()), m_LastFrame.size());
+			}
+		}
+	}
+
+	bool FrameCapture::WriteY4mFrame(const std::vector<uint8_t>& pixels)
+	{
+		// BT.601 studio range, alpha is dropped
+		const size_t pixelCount{ static_cast<size_t>(m_Width) * m_Height };
+		uint8_t* pY{ m_Planes.data() };
+		uint8_t* pU{ pY + pixelCount };
+		uint8_t* pV{ pU + pixelCount };
+
+		for (size_t i = 0; i < pixelCount; ++i)
+		{
+			const int r{ pixels[4 * i] };
+			const int g{ pixels[4 * i + 1] };
+			const int b{ pixels[4 * i + 2] };
+
+			pY[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			pU[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			pV[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+
+		m_Stream << "FRAME\n";
+		m_Stream.write(reinterpret_cast<const char*>(m_Planes.data()), m_Planes.size());
+		++m_StreamFrames;
+		return m_Stream.good();
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SDL_Surface;
+
+namespace dae
+{
+	enum class CaptureFormat
+	{
+		Png,		// one file per frame, the path is a printf pattern with the frame number
+		Y4m,		// YUV4MPEG2 4:4:4 stream, plays in most video tools
+		RawRgba		// headerless RGBA8 frames back to back
+	};
+
+	// Finished frames written to disk on their own thread. Submit copies the frame into one of a fixed ring of
+	// buffers and returns; when the writer is behind and no buffer is free the frame is dropped and counted,
+	// capture never stalls the renderer. A stream has no frame numbers, there the frame before a dropped one is
+	// written again so the stream keeps its declared rate (as long as every frame is submitted)
+	class FrameCapture final
+	{
+	public:
+		static constexpr int defaultSlotCount{ 4 };
+
+		// Format from the extension: .png, .y4m, anything else raw RGBA. A .png path either has no % (the frame
+		// number goes in front of the extension) or is a frame number pattern, otherwise the capture does not open
+		FrameCapture(const std::string& path, int width, int height, float frameRate, int slotCount = defaultSlotCount);
+		~FrameCapture();
+
+		FrameCapture(const FrameCapture&) = delete;
+		FrameCapture(FrameCapture&&) noexcept = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+		FrameCapture& operator=(FrameCapture&&) noexcept = delete;
+
+		// Frame has to be width x height, any 32 bit format. False when it was dropped
+		bool Submit(SDL_Surface* pFrame);
+
+		// Exactly one frame number conversion (%d or %0Nd) and otherwise only %% escapes,
+		// anything else must not reach printf
+		static bool IsFrameNumberPattern(const std::string& pattern);
+		static CaptureFormat GetFormat(const std::string& path);
+
+		// Writes what is queued and stops the writer, the counts are final after this
+		void Close();
+
+		bool IsOpen() const { return m_IsOpen; }
+		CaptureFormat GetFormat() const { return m_Format; }
+		const std::string& GetPath() const { return m_Path; }
+		int GetSubmittedFrames() const { return m_SubmittedFrames; }
+		int GetDroppedFrames() const { return m_DroppedFrames; }
+		// Frames the writer could not save
+		int GetFailedFrames() const { return m_FailedFrames; }
+
+	private:
+		struct QueuedFrame
+		{
+			int slot{};
+			int frameNumber{};
+		};
+
+		std::string m_Path{};
+		CaptureFormat m_Format{ CaptureFormat::RawRgba };
+		int m_Width{};
+		int m_Height{};
+		bool m_IsOpen{ false };
+
+		// Y4m and raw stream into one file
+		std::ofstream m_Stream{};
+		std::vector<uint8_t> m_Planes{};
+		std::vector<uint8_t> m_LastFrame{};	// raw only, Y4m repeats m_Planes
+		int m_StreamFrames{};
+
+		// RGBA8 frames, rows packed
+		std::vector<std::vector<uint8_t>> m_Slots{};
+		std::vector<int> m_FreeSlots{};
+		std::deque<QueuedFrame> m_Queue{};
+		int m_SubmittedFrames{};
+		int m_DroppedFrames{};
+		std::atomic<int> m_FailedFrames{};
+		bool m_IsStopping{ false };
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_FrameQueued{};
+		std::thread m_Thread{};
+
+		void WriteLoop();
+		bool WriteFrame(const std::vector<uint8_t>& pixels, int frameNumber);
+		bool WriteY4mFrame(const std::vector<uint8_t>& pixels);
+		void RepeatStreamFrames(int frameCount);
+	};
+}
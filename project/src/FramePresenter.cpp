@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "FramePresenter.h"
+
+namespace dae
+{
+	FramePresenter::FramePresenter(SDL_Window* pWindow, SDL_Surface* pWindowSurface, int queuedFrames) :
+		m_pWindow{ pWindow },
+		m_pWindowSurface{ pWindowSurface },
+		m_QueuedFrames{ std::clamp(queuedFrames, 1, maxQueuedFrames) }
+	{
+		for (int i = 0; i < frameCount; ++i)
+		{
+			SDL_Surface* pFrame{ SDL_CreateRGBSurfaceWithFormat(0, pWindowSurface->w, pWindowSurface->h, 32, pWindowSurface->format->format) };
+			if (!pFrame)
+				pFrame = SDL_CreateRGBSurface(0, pWindowSurface->w, pWindowSurface->h, 32, 0, 0, 0, 0);
+
+			m_Frames.push_back(pFrame);
+			m_FreeFrames.push_back(pFrame);
+		}
+
+		m_Thread = std::thread{ [this]() { PresentLoop(); } };
+	}
+
+	FramePresenter::~FramePresenter()
+	{
+		// Frames already submitted are still shown
+		Flush();
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_StateChanged.notify_all();
+		m_Thread.join();
+
+		for (SDL_Surface* pFrame : m_Frames)
+		{
+			SDL_FreeSurface(pFrame);
+		}
+		m_Frames.clear();
+		m_FreeFrames.clear();
+	}
+
+	template<typename Predicate>
+	void FramePresenter::WaitShowing(std::unique_lock<std::mutex>& lock, Predicate isDone)
+	{
+		while (true)
+		{
+			m_StateChanged.wait(lock, [this, &isDone]() { return m_IsBlitted || isDone(); });
+			if (!m_IsBlitted)
+				return;
+
+			lock.unlock();
+			SDL_UpdateWindowSurface(m_pWindow);
+			lock.lock();
+
+			m_IsBlitted = false;
+			m_StateChanged.notify_all();
+		}
+	}
+
+	SDL_Surface* FramePresenter::AcquireFrame()
+	{
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		WaitShowing(lock, [this]() { return !m_FreeFrames.empty() && static_cast<int>(m_Queue.size()) < m_QueuedFrames; });
+
+		SDL_Surface* pFrame{ m_FreeFrames.back() };
+		m_FreeFrames.pop_back();
+		return pFrame;
+	}
+
+	void FramePresenter::SubmitFrame(SDL_Surface* pFrame)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_Queue.push_back(pFrame);
+		}
+		m_StateChanged.notify_all();
+	}
+
+	void FramePresenter::ShowFrame()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			if (!m_IsBlitted)
+				return;
+		}
+
+		// The presenter thread does not touch the window surface until the flag is cleared
+		SDL_UpdateWindowSurface(m_pWindow);
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_IsBlitted = false;
+		}
+		m_StateChanged.notify_all();
+	}
+
+	void FramePresenter::Flush()
+	{
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		WaitShowing(lock, [this]() { return m_Queue.empty() && !m_IsPresenting; });
+	}
+
+	bool FramePresenter::IsIdle()
+	{
+		std::lock_guard<std::mutex> lock{ m_Mutex };
+		return m_Queue.empty() && !m_IsPresenting && !m_IsBlitted;
+	}
+
+	void FramePresenter::SetQueuedFrames(int queuedFrames)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_QueuedFrames = std::clamp(queuedFrames, 1, maxQueuedFrames);
+		}
+		m_StateChanged.notify_all();
+	}
+
+	void FramePresenter::PresentLoop()
+	{
+		while (true)
+		{
+			SDL_Surface* pFrame{};
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_StateChanged.wait(lock, [this]() { return m_IsStopping || (!m_Queue.empty() && !m_IsBlitted); });
+
+				// Flushed before stopping, so nothing is left
+				if (m_IsStopping)
+					return;
+
+				pFrame = m_Queue.front();
+				m_Queue.pop_front();
+				m_IsPresenting = true;
+			}
+
+			// Only the blit (and format conversion) happens here, the main thread shows it
+			SDL_BlitSurface(pFrame, nullptr, m_pWindowSurface, nullptr);
+
+			{
+				std::lock_guard<std::mutex> lock{ m_Mutex };
+				m_FreeFrames.push_back(pFrame);
+				m_IsPresenting = false;
+				m_IsBlitted = true;
+			}
+			m_StateChanged.notify_all();
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct SDL_Window;
+struct SDL_Surface;
+
+namespace dae
+{
+	// Software frames presented on their own thread: the renderer fills the next frame while the previous one
+	// is blitted (and converted) into the window surface. At most queuedFrames finished frames wait, which bounds
+	// the added latency. SDL window calls are not thread safe, so the blitted frame is only put on screen by the
+	// main thread in ShowFrame. Every queued frame costs a full frame copy into the window surface
+	class FramePresenter final
+	{
+	public:
+		static constexpr int frameCount{ 3 };
+		static constexpr int maxQueuedFrames{ frameCount - 1 };
+
+		// Frames share the window surface's pixel format, so presenting is a plain copy
+		FramePresenter(SDL_Window* pWindow, SDL_Surface* pWindowSurface, int queuedFrames = 1);
+		~FramePresenter();
+
+		FramePresenter(const FramePresenter&) = delete;
+		FramePresenter(FramePresenter&&) noexcept = delete;
+		FramePresenter& operator=(const FramePresenter&) = delete;
+		FramePresenter& operator=(FramePresenter&&) noexcept = delete;
+
+		// Main thread only. Blocks while the queue is full or every frame is in use, showing frames meanwhile
+		SDL_Surface* AcquireFrame();
+		void SubmitFrame(SDL_Surface* pFrame);
+
+		// Main thread only: updates the window when a frame was blitted into it, does not block
+		void ShowFrame();
+		// Main thread only: waits until every submitted frame is on screen, needed before anything else touches the window
+		void Flush();
+		// Nothing queued, being blitted or waiting to be shown
+		bool IsIdle();
+
+		void SetQueuedFrames(int queuedFrames);
+		int GetQueuedFrames() const { return m_QueuedFrames; }
+
+	private:
+		SDL_Window* m_pWindow{};
+		SDL_Surface* m_pWindowSurface{};
+
+		std::vector<SDL_Surface*> m_Frames{};
+		std::vector<SDL_Surface*> m_FreeFrames{};
+		std::deque<SDL_Surface*> m_Queue{};
+		int m_QueuedFrames{ 1 };
+		bool m_IsPresenting{ false };
+		// The window surface holds a frame that is not on screen yet, the next blit waits for it
+		bool m_IsBlitted{ false };
+		bool m_IsStopping{ false };
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_StateChanged{};
+		std::thread m_Thread{};
+
+		void PresentLoop();
+		// Waits for isDone, showing blitted frames while it waits (the presenter thread would stall on them)
+		template<typename Predicate>
+		void WaitShowing(std::unique_lock<std::mutex>& lock, Predicate isDone);
+	};
+}
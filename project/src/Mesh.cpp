@@ -1,12 +1,18 @@
 #include "pch.h"
 #include "Mesh.h"
+#include <cstring>
 
-Mesh::Mesh(ID3D11Device* pDevice, std::vector<uint32_t> indices, std::vector<Vertex_PosCol> vertices) :
-	m_pEffect{ new Effect( pDevice, L"resources/PosCol3D.fx" ) },
-	m_pTechnique{ m_pEffect->GetTechnique() },
+Mesh::Mesh(ID3D11Device* pDevice, std::vector<uint32_t> indices, std::vector<Vertex_PosCol> vertices, PrimitiveTopology topology) :
 	m_Indices{ indices },
-	m_Vertices{ vertices }
+	m_Vertices{ vertices },
+	m_PrimitiveTopology{ topology }
 {
+	// Without a device (headless) the mesh only feeds the software rasterizer
+	if (!pDevice)
+		return;
+
+	m_pEffect = new Effect(pDevice, L"resources/PosCol3D.fx");
+	m_pTechnique = m_pEffect->GetTechnique();
 	CreateLayoutAndBuffers(pDevice, m_Vertices, m_Indices);
 }
 
@@ -27,6 +33,16 @@ Mesh::~Mesh()
 		m_pInputLayout->Release();
 		m_pInputLayout = nullptr;
 	}
+	if (m_pInstanceBuffer)
+	{
+		m_pInstanceBuffer->Release();
+		m_pInstanceBuffer = nullptr;
+	}
+	if (m_pInstancedInputLayout)
+	{
+		m_pInstancedInputLayout->Release();
+		m_pInstancedInputLayout = nullptr;
+	}
 	if (m_pEffect)
 	{
 		delete m_pEffect;
@@ -36,47 +52,130 @@ Mesh::~Mesh()
 	
 }
 
-void Mesh::Render(ID3D11DeviceContext* pDeviceContext) const
+void Mesh::Render(ID3D11DeviceContext* pDeviceContext, bool isTransparent) const
 {
 	
 
 	// 1. Set Primitive topology
-	pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	if (m_PrimitiveTopology == PrimitiveTopology::TriangleStrip)
+	{
+		pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	}
+	else
+	{
+		pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	}
+
+	// Instances go through the second input slot in one draw call
+	const bool isInstanced{ m_pInstanceBuffer != nullptr };
+	const UINT numInstances{ static_cast<UINT>(m_InstanceWorlds.size()) };
 
 	// 2. Set Input Layout
 	//pDeviceContext->IASetInputLayout(m_pEffect->GetInputLayout());
-	pDeviceContext->IASetInputLayout(m_pInputLayout);
+	pDeviceContext->IASetInputLayout(isInstanced ? m_pInstancedInputLayout : m_pInputLayout);
 
 	// 3. Set VertexBuffer
-	constexpr UINT stride = sizeof(Vertex_PosCol);
-	constexpr UINT offset = 0;
-	pDeviceContext->IASetVertexBuffers(0, 1, &m_pVertexBuffer, &stride, &offset);
+	ID3D11Buffer* const pBuffers[2]{ m_pVertexBuffer, m_pInstanceBuffer };
+	constexpr UINT strides[2]{ sizeof(Vertex_PosCol), sizeof(Matrix) };
+	constexpr UINT offsets[2]{ 0, 0 };
+	pDeviceContext->IASetVertexBuffers(0, isInstanced ? 2 : 1, pBuffers, strides, offsets);
 
 	// 4. Set IndexBuffer
 	pDeviceContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
 
 	// 5. Draw
+	ID3DX11EffectTechnique* pTechnique{};
+	if (isTransparent)
+	{
+		pTechnique = isInstanced ? m_pEffect->GetTransparentInstancedTechnique() : m_pEffect->GetTransparentTechnique();
+	}
+	else
+	{
+		pTechnique = isInstanced ? m_pEffect->GetInstancedTechnique() : m_pEffect->GetTechnique();
+	}
 	D3DX11_TECHNIQUE_DESC techDesc{};
-	m_pEffect->GetTechnique()->GetDesc(&techDesc);
+	pTechnique->GetDesc(&techDesc);
 	for (UINT p = 0; p < techDesc.Passes; ++p) {
-		m_pEffect->GetTechnique()->GetPassByIndex(p)->Apply(0, pDeviceContext);
-		pDeviceContext->DrawIndexed(m_NumIndices, 0, 0);
+		pTechnique->GetPassByIndex(p)->Apply(0, pDeviceContext);
+		if (isInstanced)
+		{
+			pDeviceContext->DrawIndexedInstanced(m_NumIndices, numInstances, 0, 0, 0);
+		}
+		else
+		{
+			pDeviceContext->DrawIndexed(m_NumIndices, 0, 0);
+		}
 	}
 }
 
 void Mesh::SetMatrix(const Matrix& wvpMatrix) const
 {
-	m_pEffect->SetMatrix(wvpMatrix);
+	if (m_pEffect)
+		m_pEffect->SetMatrix(wvpMatrix);
+}
+
+void Mesh::SetWorldMatrix(const Matrix& world) const
+{
+	if (m_pEffect)
+		m_pEffect->SetWorldMatrix(world);
+}
+
+void Mesh::SetViewProjectionMatrix(const Matrix& viewProjection) const
+{
+	if (m_pEffect)
+		m_pEffect->SetViewProjectionMatrix(viewProjection);
+}
+
+void Mesh::SetInstances(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const std::vector<Matrix>& instanceWorlds)
+{
+	static_assert(sizeof(Matrix) == 16 * sizeof(float), "Instance data is uploaded as raw float4x4");
+
+	if (instanceWorlds.empty())
+	{
+		// Back to a single, non-instanced draw
+		m_InstanceWorlds = { Matrix{} };
+		if (m_pInstanceBuffer)
+		{
+			m_pInstanceBuffer->Release();
+			m_pInstanceBuffer = nullptr;
+		}
+		m_InstanceCapacity = 0;
+		return;
+	}
+
+	m_InstanceWorlds = instanceWorlds;
+
+	// The software rasterizer only needs the matrices
+	if (!pDevice)
+		return;
+
+	const uint32_t numInstances{ static_cast<uint32_t>(m_InstanceWorlds.size()) };
+	if (numInstances > m_InstanceCapacity)
+	{
+		CreateInstanceBuffer(pDevice, numInstances);
+	}
+
+	if (!m_pInstanceBuffer)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped{};
+	if (FAILED(pDeviceContext->Map(m_pInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+
+	std::memcpy(mapped.pData, m_InstanceWorlds.data(), sizeof(Matrix) * numInstances);
+	pDeviceContext->Unmap(m_pInstanceBuffer, 0);
 }
 
 void Mesh::SetDiffuseMap(Texture* texture) const
 {
-	m_pEffect->SetDiffuseMap(texture);
+	if (m_pEffect)
+		m_pEffect->SetDiffuseMap(texture);
 }
 
-void Mesh::ToggleTechnique()
+void Mesh::SetTechniqueIndex(int techniqueIdx)
 {
-	m_pEffect->ToggleTechnique();
+	if (m_pEffect)
+		m_pEffect->SetTechniqueIndex(techniqueIdx);
 }
 
 void Mesh::CreateLayoutAndBuffers(ID3D11Device* pDevice, const std::vector<Vertex_PosCol>& vertices, const std::vector<uint32_t>& indices)
@@ -120,7 +219,7 @@ void Mesh::CreateVertexLayout(ID3D11Device* pDevice)
 	D3DX11_PASS_DESC passDesc{};
 	m_pTechnique->GetPassByIndex(0)->GetDesc(&passDesc);
 
-	const HRESULT result = pDevice->CreateInputLayout(
+	HRESULT result = pDevice->CreateInputLayout(
 		vertexDesc,
 		numElements,
 		passDesc.pIAInputSignature,
@@ -129,7 +228,63 @@ void Mesh::CreateVertexLayout(ID3D11Device* pDevice)
 
 	if (FAILED(result))
 		return;
+
+	// Instanced layout: same vertex data in slot 0, a world matrix per instance in slot 1
+	static constexpr uint32_t numInstancedElements{ numElements + 4 };
+	D3D11_INPUT_ELEMENT_DESC instancedDesc[numInstancedElements]{};
+	for (uint32_t i = 0; i < numElements; ++i)
+	{
+		instancedDesc[i] = vertexDesc[i];
+	}
+	for (uint32_t row = 0; row < 4; ++row)
+	{
+		D3D11_INPUT_ELEMENT_DESC& element{ instancedDesc[numElements + row] };
+		element.SemanticName = "WORLD";
+		element.SemanticIndex = row;
+		element.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		element.InputSlot = 1;
+		element.AlignedByteOffset = row * 16;
+		element.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		element.InstanceDataStepRate = 1;
+	}
+
+	m_pEffect->GetInstancedTechnique()->GetPassByIndex(0)->GetDesc(&passDesc);
+
+	result = pDevice->CreateInputLayout(
+		instancedDesc,
+		numInstancedElements,
+		passDesc.pIAInputSignature,
+		passDesc.IAInputSignatureSize,
+		&m_pInstancedInputLayout);
+
+	if (FAILED(result))
+		return;
 }
+
+void Mesh::CreateInstanceBuffer(ID3D11Device* pDevice, uint32_t capacity)
+{
+	if (m_pInstanceBuffer)
+	{
+		m_pInstanceBuffer->Release();
+		m_pInstanceBuffer = nullptr;
+	}
+	m_InstanceCapacity = 0;
+
+	// Dynamic, so fleets can be moved every frame with WRITE_DISCARD
+	D3D11_BUFFER_DESC bd = {};
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.ByteWidth = sizeof(Matrix) * capacity;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.MiscFlags = 0;
+
+	const HRESULT result = pDevice->CreateBuffer(&bd, nullptr, &m_pInstanceBuffer);
+	if (FAILED(result))
+		return;
+
+	m_InstanceCapacity = capacity;
+}
+
 void Mesh::CreateVertexBuffer(ID3D11Device* pDevice, const std::vector<Vertex_PosCol>& vertices, const std::vector<uint32_t>& indices)
 {
 	// Create Vertex Buffer
@@ -38,7 +38,8 @@ enum class PrimitiveTopology
 class Mesh
 {
 public:
-    Mesh(ID3D11Device* pDevice, std::vector<uint32_t> indices, std::vector<Vertex_PosCol> vertices);
+    // pDevice may be null, the mesh then has no effect or buffers and can only be rasterized in software
+    Mesh(ID3D11Device* pDevice, std::vector<uint32_t> indices, std::vector<Vertex_PosCol> vertices, PrimitiveTopology topology = PrimitiveTopology::TriangleList);
 	~Mesh();
 
 	Mesh(const Mesh&) = delete;
@@ -46,15 +47,23 @@ public:
 	Mesh& operator=(const Mesh&) = delete;
 	Mesh& operator=(Mesh&&) noexcept = delete;
 
-	void Render(ID3D11DeviceContext* pDeviceContext) const;
+	// Transparent draws use the blended techniques of the effect
+	void Render(ID3D11DeviceContext* pDeviceContext, bool isTransparent = false) const;
 	void SetMatrix(const Matrix& wvpMatrix) const;
+	void SetWorldMatrix(const Matrix& world) const;
+	void SetViewProjectionMatrix(const Matrix& viewProjection) const;
+	void SetInstances(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const std::vector<Matrix>& instanceWorlds);
     void SetDiffuseMap(Texture* texture) const;
 
-    void ToggleTechnique();
+    void SetTechniqueIndex(int techniqueIdx);
 	
 	std::vector<uint32_t>& GetIndices() { return m_Indices; }
 	std::vector<Vertex_Out>& GetVerticesOut() { return m_Vertices_out; }
 	std::vector<Vertex_PosCol>& GetVertices() { return m_Vertices; }
+	std::vector<bool>& GetInstancesVisible() { return m_InstancesVisible; }
+
+	// Always holds at least one (identity) instance
+	const std::vector<Matrix>& GetInstances() const { return m_InstanceWorlds; }
 
 	PrimitiveTopology GetTopology() { return m_PrimitiveTopology; }
 
@@ -63,11 +72,14 @@ private:
 
 	void CreateVertexLayout(ID3D11Device* pDevice);
 	void CreateVertexBuffer(ID3D11Device* pDevice, const std::vector<Vertex_PosCol>& vertices, const std::vector<uint32_t>& indices);
+	void CreateInstanceBuffer(ID3D11Device* pDevice, uint32_t capacity);
     
     // DirectX resources
     ID3D11Buffer* m_pVertexBuffer{ nullptr };
     ID3D11Buffer* m_pIndexBuffer{ nullptr };
     ID3D11InputLayout* m_pInputLayout{ nullptr };
+    ID3D11Buffer* m_pInstanceBuffer{ nullptr };
+    ID3D11InputLayout* m_pInstancedInputLayout{ nullptr };
 
     // Effect and technique
     Effect* m_pEffect{ nullptr };
@@ -75,10 +87,15 @@ private:
 
     // Buffer sizes
     uint32_t m_NumIndices{ 0 };
+    uint32_t m_InstanceCapacity{ 0 };
 
 	std::vector<uint32_t> m_Indices{};
 	std::vector<Vertex_PosCol> m_Vertices{};
 	std::vector<Vertex_Out> m_Vertices_out{};
 
+	// Per-instance world matrices, vertices_out holds every instance back to back
+	std::vector<Matrix> m_InstanceWorlds{ Matrix{} };
+	std::vector<bool> m_InstancesVisible{};
+
 	PrimitiveTopology m_PrimitiveTopology{ PrimitiveTopology::TriangleList };
 };
@@ -0,0 +1,284 @@
+#include "pch.h"
+#include "PixelShader.h"
+#include "Scene.h"
+
+namespace dae
+{
+	void FragmentPacket::Add(int index, float fragmentDepth, const Vector2& uv, const Vector3& fragmentNormal, const Vector3& fragmentTangent, const Vector3& fragmentViewDirection)
+	{
+		u[count] = uv.x;
+		v[count] = uv.y;
+		normal[0][count] = fragmentNormal.x;
+		normal[1][count] = fragmentNormal.y;
+		normal[2][count] = fragmentNormal.z;
+		tangent[0][count] = fragmentTangent.x;
+		tangent[1][count] = fragmentTangent.y;
+		tangent[2][count] = fragmentTangent.z;
+		viewDirection[0][count] = fragmentViewDirection.x;
+		viewDirection[1][count] = fragmentViewDirection.y;
+		viewDirection[2][count] = fragmentViewDirection.z;
+		depth[count] = fragmentDepth;
+		pixelIndex[count] = index;
+		++count;
+	}
+
+	void FragmentPacket::Pad()
+	{
+		for (int k{ count }; k < capacity; ++k)
+		{
+			u[k] = u[0];
+			v[k] = v[0];
+			depth[k] = depth[0];
+			for (int c{ 0 }; c < 3; ++c)
+			{
+				normal[c][k] = normal[c][0];
+				tangent[c][k] = tangent[c][0];
+				viewDirection[c][k] = viewDirection[c][0];
+			}
+		}
+	}
+
+	namespace
+	{
+		// Same light as PosCol3D.fx
+		const __m128 lightDirection[3]{ _mm_set1_ps(0.577f), _mm_set1_ps(-0.577f), _mm_set1_ps(0.577f) };
+		constexpr float lightIntensity{ 7.f };
+		constexpr float shininess{ 25.f };
+		constexpr float ambient{ 0.03f };
+
+		inline __m128 Dot(const __m128 a[3], const __m128 b[3])
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+		}
+
+		inline void Normalize(__m128 v[3])
+		{
+			const __m128 invLength{ _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(Dot(v, v))) };
+			for (int c{ 0 }; c < 3; ++c)
+			{
+				v[c] = _mm_mul_ps(v[c], invLength);
+			}
+		}
+
+		inline void SampleDiffuse(const Material& material, __m128 u, __m128 v, float lod, SamplerFilter filter, __m128 diffuse[3])
+		{
+			if (material.pVirtualDiffuseMap)
+				material.pVirtualDiffuseMap->Sample4(u, v, lod, filter, diffuse[0], diffuse[1], diffuse[2]);
+			else
+				material.pDiffuseMap->Sample4(u, v, lod, filter, diffuse[0], diffuse[1], diffuse[2]);
+		}
+
+		// Lambert diffuse + Phong specular (gloss scales the exponent) for 4 lanes starting at first
+		template<ShadingMode mode, bool useNormalMap, SamplerFilter filter>
+		void ShadeQuad(const FragmentPacket& packet, int first, const Material& material, float lod, ShadedPacket& output)
+		{
+			const __m128 u{ _mm_load_ps(packet.u + first) };
+			const __m128 v{ _mm_load_ps(packet.v + first) };
+			const __m128 zero{ _mm_setzero_ps() };
+
+			__m128 normal[3]{ _mm_load_ps(packet.normal[0] + first), _mm_load_ps(packet.normal[1] + first), _mm_load_ps(packet.normal[2] + first) };
+			Normalize(normal);
+
+			// Tangent space normal, rows T, B = cross(N, T), N like the HLSL version
+			if constexpr (useNormalMap)
+			{
+				__m128 tangent[3]{ _mm_load_ps(packet.tangent[0] + first), _mm_load_ps(packet.tangent[1] + first), _mm_load_ps(packet.tangent[2] + first) };
+				Normalize(tangent);
+
+				const __m128 binormal[3]{
+					_mm_sub_ps(_mm_mul_ps(normal[1], tangent[2]), _mm_mul_ps(normal[2], tangent[1])),
+					_mm_sub_ps(_mm_mul_ps(normal[2], tangent[0]), _mm_mul_ps(normal[0], tangent[2])),
+					_mm_sub_ps(_mm_mul_ps(normal[0], tangent[1]), _mm_mul_ps(normal[1], tangent[0])) };
+
+				__m128 sampled[3];
+				material.pNormalMap->Sample4(u, v, lod, filter, sampled[0], sampled[1], sampled[2]);
+
+				const __m128 two{ _mm_set1_ps(2.f) };
+				const __m128 one{ _mm_set1_ps(1.f) };
+				for (int c{ 0 }; c < 3; ++c)
+				{
+					sampled[c] = _mm_sub_ps(_mm_mul_ps(sampled[c], two), one);
+				}
+
+				for (int c{ 0 }; c < 3; ++c)
+				{
+					normal[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tangent[c], sampled[0]), _mm_mul_ps(binormal[c], sampled[1])), _mm_mul_ps(normal[c], sampled[2]));
+				}
+				Normalize(normal);
+			}
+
+			// Light travels along lightDirection, so the surface faces it with -dot
+			const __m128 observedArea{ _mm_max_ps(zero, _mm_sub_ps(zero, Dot(normal, lightDirection))) };
+			if constexpr (mode == ShadingMode::ObservedArea)
+			{
+				_mm_store_ps(output.r + first, observedArea);
+				_mm_store_ps(output.g + first, observedArea);
+				_mm_store_ps(output.b + first, observedArea);
+				_mm_store_ps(output.a + first, _mm_set1_ps(1.f));
+				return;
+			}
+
+			__m128 diffuse[3]{};
+			if constexpr (mode != ShadingMode::Specular)
+			{
+				SampleDiffuse(material, u, v, lod, filter, diffuse);
+
+				const __m128 lambert{ _mm_mul_ps(observedArea, _mm_set1_ps(lightIntensity / PI)) };
+				for (int c{ 0 }; c < 3; ++c)
+				{
+					diffuse[c] = _mm_mul_ps(diffuse[c], lambert);
+				}
+			}
+
+			__m128 specular{ zero };
+			if (mode != ShadingMode::Diffuse && material.pSpecularMap && material.pGlossMap)
+			{
+				__m128 viewDirection[3]{ _mm_load_ps(packet.viewDirection[0] + first), _mm_load_ps(packet.viewDirection[1] + first), _mm_load_ps(packet.viewDirection[2] + first) };
+				Normalize(viewDirection);
+
+				// reflect(l, n) = l - 2 * dot(n, l) * n, compared against the direction towards the camera
+				const __m128 twoNDotL{ _mm_mul_ps(_mm_set1_ps(2.f), Dot(normal, lightDirection)) };
+				__m128 reflected[3];
+				for (int c{ 0 }; c < 3; ++c)
+				{
+					reflected[c] = _mm_sub_ps(lightDirection[c], _mm_mul_ps(twoNDotL, normal[c]));
+				}
+				const __m128 cosAlpha{ _mm_max_ps(zero, _mm_sub_ps(zero, Dot(reflected, viewDirection))) };
+
+				__m128 reflectance, gloss, unused0, unused1;
+				material.pSpecularMap->Sample4(u, v, lod, filter, reflectance, unused0, unused1);
+				material.pGlossMap->Sample4(u, v, lod, filter, gloss, unused0, unused1);
+
+				alignas(16) float cosAlphaLanes[4];
+				alignas(16) float exponentLanes[4];
+				alignas(16) float reflectanceLanes[4];
+				alignas(16) float specularLanes[4];
+				_mm_store_ps(cosAlphaLanes, cosAlpha);
+				_mm_store_ps(exponentLanes, _mm_mul_ps(gloss, _mm_set1_ps(shininess)));
+				_mm_store_ps(reflectanceLanes, reflectance);
+				for (int k{ 0 }; k < 4; ++k)
+				{
+					specularLanes[k] = reflectanceLanes[k] * std::pow(cosAlphaLanes[k], exponentLanes[k]);
+				}
+				specular = _mm_mul_ps(_mm_load_ps(specularLanes), observedArea);
+			}
+
+			__m128 color[3];
+			if constexpr (mode == ShadingMode::Diffuse)
+			{
+				color[0] = diffuse[0];
+				color[1] = diffuse[1];
+				color[2] = diffuse[2];
+			}
+			else if constexpr (mode == ShadingMode::Specular)
+			{
+				color[0] = color[1] = color[2] = specular;
+			}
+			else
+			{
+				for (int c{ 0 }; c < 3; ++c)
+				{
+					color[c] = _mm_add_ps(_mm_add_ps(diffuse[c], specular), _mm_set1_ps(ambient));
+				}
+			}
+
+			_mm_store_ps(output.r + first, color[0]);
+			_mm_store_ps(output.g + first, color[1]);
+			_mm_store_ps(output.b + first, color[2]);
+			_mm_store_ps(output.a + first, _mm_set1_ps(1.f));
+		}
+
+		template<ShadingMode mode, bool useNormalMap, SamplerFilter filter>
+		void ShadePhong(const FragmentPacket& packet, const ShaderContext& context, ShadedPacket& output)
+		{
+			for (int quad{ 0 }; quad < packet.GetQuadCount(); ++quad)
+			{
+				ShadeQuad<mode, useNormalMap, filter>(packet, quad * 4, *context.pMaterial, context.lod, output);
+			}
+		}
+
+		// Every state combination compiled on its own, indexed [mode][normal map][filter]
+		template<ShadingMode mode, bool useNormalMap>
+		constexpr ShadeFunction phongFilters[3]{
+			&ShadePhong<mode, useNormalMap, SamplerFilter::Point>,
+			&ShadePhong<mode, useNormalMap, SamplerFilter::Linear>,
+			&ShadePhong<mode, useNormalMap, SamplerFilter::Anisotropic> };
+
+		template<ShadingMode mode>
+		constexpr const ShadeFunction* phongNormalMaps[2]{ phongFilters<mode, false>, phongFilters<mode, true> };
+
+		constexpr const ShadeFunction* const* phongKernels[4]{
+			phongNormalMaps<ShadingMode::Combined>,
+			phongNormalMaps<ShadingMode::ObservedArea>,
+			phongNormalMaps<ShadingMode::Diffuse>,
+			phongNormalMaps<ShadingMode::Specular> };
+
+		ShadeFunction SelectPhong(const ShaderContext& context)
+		{
+			const bool useNormalMap{ context.useNormalMap && context.pMaterial->pNormalMap };
+			return phongKernels[static_cast<int>(context.shadingMode)][useNormalMap][static_cast<int>(context.filter)];
+		}
+
+		// Diffuse map only, like the fireFX technique
+		void UnlitShader(const FragmentPacket& packet, const ShaderContext& context, ShadedPacket& output)
+		{
+			for (int quad{ 0 }; quad < packet.GetQuadCount(); ++quad)
+			{
+				const int first{ quad * 4 };
+
+				const __m128 u{ _mm_load_ps(packet.u + first) };
+				const __m128 v{ _mm_load_ps(packet.v + first) };
+				const Material& material{ *context.pMaterial };
+
+				// Virtual textures are opaque
+				__m128 diffuse[4];
+				if (material.pVirtualDiffuseMap)
+				{
+					material.pVirtualDiffuseMap->Sample4(u, v, context.lod, context.filter, diffuse[0], diffuse[1], diffuse[2]);
+					diffuse[3] = _mm_set1_ps(1.f);
+				}
+				else
+				{
+					material.pDiffuseMap->Sample4(u, v, context.lod, context.filter, diffuse[0], diffuse[1], diffuse[2], diffuse[3]);
+				}
+
+				_mm_store_ps(output.r + first, diffuse[0]);
+				_mm_store_ps(output.g + first, diffuse[1]);
+				_mm_store_ps(output.b + first, diffuse[2]);
+				_mm_store_ps(output.a + first, diffuse[3]);
+			}
+		}
+	}
+
+	PixelShaderRegistry::PixelShaderRegistry()
+	{
+		Register("Phong", SelectPhong);
+		Register("Unlit", [](const ShaderContext&) -> ShadeFunction { return &UnlitShader; });
+	}
+
+	uint32_t PixelShaderRegistry::Register(const std::string& name, PixelShader shader)
+	{
+		const auto it{ m_ShaderIds.find(name) };
+		if (it != m_ShaderIds.end())
+		{
+			m_Shaders[it->second] = std::move(shader);
+			return it->second;
+		}
+
+		m_Shaders.push_back(std::move(shader));
+		const uint32_t shaderId{ static_cast<uint32_t>(m_Shaders.size() - 1) };
+		m_ShaderIds.emplace(name, shaderId);
+		return shaderId;
+	}
+
+	uint32_t PixelShaderRegistry::Find(const std::string& name) const
+	{
+		const auto it{ m_ShaderIds.find(name) };
+		return it != m_ShaderIds.end() ? it->second : phongShaderId;
+	}
+
+	const PixelShader& PixelShaderRegistry::Get(uint32_t shaderId) const
+	{
+		return shaderId < m_Shaders.size() ? m_Shaders[shaderId] : m_Shaders[phongShaderId];
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "Math.h"
+#include "Texture.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dae
+{
+	struct Material;
+
+	// Software shading modes (F5)
+	enum class ShadingMode
+	{
+		Combined,
+		ObservedArea,
+		Diffuse,
+		Specular
+	};
+
+	// Interpolated varyings of the fragments that passed the depth test (SoA), shaded in one call
+	struct FragmentPacket
+	{
+		static constexpr int capacity{ 8 };
+
+		alignas(16) float u[capacity]{};
+		alignas(16) float v[capacity]{};
+		alignas(16) float normal[3][capacity]{};
+		alignas(16) float tangent[3][capacity]{};
+		alignas(16) float viewDirection[3][capacity]{};
+		// View depth (w), weights transparent fragments
+		alignas(16) float depth[capacity]{};
+		int pixelIndex[capacity]{};
+		int count{};
+
+		void Add(int index, float fragmentDepth, const Vector2& uv, const Vector3& fragmentNormal, const Vector3& fragmentTangent, const Vector3& fragmentViewDirection);
+		// Unused lanes repeat the first fragment
+		void Pad();
+
+		// Groups of 4 lanes that hold fragments
+		int GetQuadCount() const { return (count + 3) / 4; }
+	};
+
+	// Linear color per fragment, the rasterizer clamps and writes it (alpha only matters for transparent materials)
+	struct ShadedPacket
+	{
+		alignas(16) float r[FragmentPacket::capacity]{};
+		alignas(16) float g[FragmentPacket::capacity]{};
+		alignas(16) float b[FragmentPacket::capacity]{};
+		alignas(16) float a[FragmentPacket::capacity]{};
+	};
+
+	// Constant over a draw, except lod which is set per triangle
+	struct ShaderContext
+	{
+		const Material* pMaterial{};
+		float lod{};
+		SamplerFilter filter{ SamplerFilter::Point };
+		ShadingMode shadingMode{ ShadingMode::Combined };
+		bool useNormalMap{ false };
+	};
+
+	// Shades one packet, the rasterizer calls it directly for every packet of a draw
+	using ShadeFunction = void(*)(const FragmentPacket&, const ShaderContext&, ShadedPacket&);
+	// Picks the kernel specialised for the draw's state, called once per draw
+	using PixelShader = std::function<ShadeFunction(const ShaderContext&)>;
+
+	// Software counterpart of the .fx techniques: materials pick a shader by id, the rasterizer only fills packets
+	class PixelShaderRegistry final
+	{
+	public:
+		static constexpr uint32_t phongShaderId{ 0 };
+
+		// Registers the built-in shaders (Phong first)
+		PixelShaderRegistry();
+
+		PixelShaderRegistry(const PixelShaderRegistry&) = delete;
+		PixelShaderRegistry(PixelShaderRegistry&&) noexcept = delete;
+		PixelShaderRegistry& operator=(const PixelShaderRegistry&) = delete;
+		PixelShaderRegistry& operator=(PixelShaderRegistry&&) noexcept = delete;
+
+		// Registering an existing name replaces its shader and keeps the id
+		uint32_t Register(const std::string& name, PixelShader shader);
+		// phongShaderId when the name is unknown
+		uint32_t Find(const std::string& name) const;
+		const PixelShader& Get(uint32_t shaderId) const;
+
+	private:
+		std::vector<PixelShader> m_Shaders{};
+		std::unordered_map<std::string, uint32_t> m_ShaderIds{};
+	};
+}
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "Renderer.h"
 #include "Utils.h"
+#include <cstring>
+#include <filesystem>
 
 namespace dae {
 
@@ -12,11 +14,59 @@ namespace dae {
 
 		//Create Buffers
 		m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
+
+		// Rasterize straight into the window when its pixels are 32 bit scanlines without padding,
+		// otherwise into our own surface that gets blitted (and converted) at present
+		m_RenderToWindow = m_pFrontBuffer
+			&& m_pFrontBuffer->format->BytesPerPixel == 4
+			&& m_pFrontBuffer->w == m_Width && m_pFrontBuffer->h == m_Height
+			&& m_pFrontBuffer->pitch == m_Width * static_cast<int>(sizeof(uint32_t));
+
+		if (m_RenderToWindow)
+			m_pBackBuffer = m_pFrontBuffer;
+		else
+			m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
+
+		// Zero copy by default, the presenter thread always copies every frame into the window
+		m_PresentLatency = m_RenderToWindow ? 0 : 1;
+
+		Initialize();
+		PrintControls();
+	}
+
+	Renderer::Renderer(int width, int height) :
+		m_Width{ width },
+		m_Height{ height }
+	{
+		// Headless: software only, frames stay in a surface of our own (see GetFrame)
+		m_Hardware = false;
 		m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-		m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+
+		Initialize();
+
+		// The camera gets no input, its start pose holds until SetCameraPose
+		m_Camera.CalculateViewMatrix();
+	}
+
+	void Renderer::Initialize()
+	{
+		// Dynamic resolution renders into this one, same format as the frames so the stretch is a plain copy
+		m_ViewportWidth = m_Width;
+		m_ViewportHeight = m_Height;
+		m_pScaledBuffer = SDL_CreateRGBSurfaceWithFormat(0, m_Width, m_Height, 32, m_pBackBuffer->format->format);
+
+		// Two or three frames in flight, presented from their own thread
+		if (m_pFrontBuffer)
+			m_pPresenter = new FramePresenter(m_pWindow, m_pFrontBuffer, std::max(m_PresentLatency, 1));
 
 		m_pDepthBufferPixels = new float[m_Width * m_Height];
 
+		// 16 byte aligned, a pixel's accumulation is one __m128
+		m_pAccumulationPixels = static_cast<float*>(_mm_malloc(sizeof(float) * 4 * m_Width * m_Height, 16));
+		std::fill_n(m_pAccumulationPixels, 4 * m_Width * m_Height, 0.f);
+		m_pRevealagePixels = new float[m_Width * m_Height];
+		std::fill_n(m_pRevealagePixels, m_Width * m_Height, 1.f);
+
 		// Get aspect ratio
 		m_AspectRatio = static_cast<float>(m_Width) / static_cast<float>(m_Height);
 
@@ -24,9 +74,12 @@ namespace dae {
 		m_Camera.Initialize(45.f, { .0f,.0f, -50.f });
 		m_Camera.CalculateProjectionMatrix(m_AspectRatio);
 
-		//Initialize DirectX pipeline
-		const HRESULT result = InitializeDirectX();
-		if (result == S_OK)
+		//Initialize DirectX pipeline, headless runs without: meshes and textures are then CPU only
+		if (!m_pWindow)
+		{
+			m_IsInitialized = true;
+		}
+		else if (InitializeDirectX() == S_OK)
 		{
 			m_IsInitialized = true;
 			std::cout << "DirectX is initialized and ready!\n";
@@ -34,22 +87,61 @@ namespace dae {
 		else
 		{
 			std::cout << "DirectX initialization failed!\n";
-		}		
-
-		// Mesh	
-		Utils::ParseOBJ("resources/vehicle.obj", m_Vertices, m_Indices);
-		m_pMesh = new Mesh(m_pDevice, m_Indices, m_Vertices);
-
-		// Textures
-		//m_pTexture = Texture::LoadFromFile("resources/uv_grid_2.png", m_pDevice);
-		m_pTexture = Texture::LoadFromFile("resources/vehicle_diffuse.png", m_pDevice);
-		m_pMesh->SetDiffuseMap(m_pTexture);
+		}
 
-		PrintControls();
+		// Textures decode on the loader pool while the meshes are parsed
+		m_pTextureManager = new TextureManager{ m_pDevice, m_LoaderPool };
+		//std::shared_future<TextureHandle> vehicleDiffuse{ m_pTextureManager->LoadAsync("resources/uv_grid_2.png") };
+		std::shared_future<TextureHandle> vehicleDiffuse{ m_pTextureManager->LoadAsync("resources/vehicle_diffuse.png", TexelLayout::Linear, TexelFormat::BC1) };
+		std::shared_future<TextureHandle> vehicleNormal{ m_pTextureManager->LoadAsync("resources/vehicle_normal.png", TexelLayout::Linear, TexelFormat::BC5) };
+		std::shared_future<TextureHandle> vehicleSpecular{ m_pTextureManager->LoadAsync("resources/vehicle_specular.png", TexelLayout::Linear, TexelFormat::BC1) };
+		std::shared_future<TextureHandle> vehicleGloss{ m_pTextureManager->LoadAsync("resources/vehicle_gloss.png", TexelLayout::Linear, TexelFormat::BC1) };
+		// The fire's soft gradients band in BC3 and its layered quads sample it many times per pixel: uncompressed, Morton ordered
+		std::shared_future<TextureHandle> fireFXDiffuse{ m_pTextureManager->LoadAsync("resources/fireFX_diffuse.png", TexelLayout::Morton, TexelFormat::RGBA8) };
+
+		// Scene
+		m_VehicleMeshId = LoadMesh("resources/vehicle.obj");
+		const uint32_t fireFXMeshId{ LoadMesh("resources/fireFX.obj") };
+
+		const TextureHandle& pPlaceholder{ m_pTextureManager->GetPlaceholder() };
+		m_Scene.AddTexture(pPlaceholder);
+		UpdateTextureResidency(pPlaceholder.get());
+
+		// Materials
+		Material vehicleMaterial{};
+		vehicleMaterial.pDiffuseMap = pPlaceholder.get();
+		m_VehicleEntryId = m_Scene.AddEntry(m_VehicleMeshId, vehicleMaterial);
+		m_PendingTextures.push_back({ vehicleDiffuse, m_VehicleEntryId, &Material::pDiffuseMap });
+		m_PendingTextures.push_back({ vehicleNormal, m_VehicleEntryId, &Material::pNormalMap });
+		m_PendingTextures.push_back({ vehicleSpecular, m_VehicleEntryId, &Material::pSpecularMap });
+		m_PendingTextures.push_back({ vehicleGloss, m_VehicleEntryId, &Material::pGlossMap });
+
+		Material fireFXMaterial{};
+		fireFXMaterial.pDiffuseMap = pPlaceholder.get();
+		fireFXMaterial.isTransparent = true;
+		fireFXMaterial.pixelShaderId = m_PixelShaders.Find("Unlit");
+		m_FireFXEntryId = m_Scene.AddEntry(fireFXMeshId, fireFXMaterial);
+		m_Scene.SetEntryVisible(m_FireFXEntryId, m_FireFX);
+		m_PendingTextures.push_back({ fireFXDiffuse, m_FireFXEntryId, &Material::pDiffuseMap });
 	}
 
 	Renderer::~Renderer()
 	{
+		StopCapture();
+
+		// Shows what is still queued, the window outlives the renderer
+		if (m_pPresenter) {
+			delete m_pPresenter;
+			m_pPresenter = nullptr;
+		}
+
+		// Waits for the loads in flight before the device goes away
+		m_PendingTextures.clear();
+		if (m_pTextureManager) {
+			delete m_pTextureManager;
+			m_pTextureManager = nullptr;
+		}
+
 		if (m_pDeviceContext) {
 			m_pDeviceContext->ClearState();
 			m_pDeviceContext->Flush();
@@ -93,38 +185,213 @@ namespace dae {
 			m_pDepthBufferPixels = nullptr;
 		}
 
-		if (m_pMesh) {
-			delete m_pMesh;
-			m_pMesh = nullptr;
+		if (m_pScaledBuffer) {
+			SDL_FreeSurface(m_pScaledBuffer);
+			m_pScaledBuffer = nullptr;
+		}
+
+		// The window surface belongs to the window
+		if (m_pBackBuffer && !m_RenderToWindow) {
+			SDL_FreeSurface(m_pBackBuffer);
+		}
+		m_pBackBuffer = nullptr;
+
+		if (m_pAccumulationPixels) {
+			_mm_free(m_pAccumulationPixels);
+			m_pAccumulationPixels = nullptr;
+		}
+
+		if (m_pRevealagePixels) {
+			delete[] m_pRevealagePixels;
+			m_pRevealagePixels = nullptr;
 		}
 
-		if (m_pTexture)
+	}
+
+	uint32_t Renderer::LoadMesh(const std::string& path)
+	{
+		std::vector<Vertex_PosCol> vertices{};
+		std::vector<uint32_t> indices{};
+		Utils::ParseOBJ(path, vertices, indices);
+
+		// Only switch to a strip when it saves a good part of the index traffic
+		PrimitiveTopology topology{ PrimitiveTopology::TriangleList };
+		std::vector<uint32_t> stripIndices{};
+		Utils::StripifyTriangleList(indices, stripIndices);
+		if (stripIndices.size() * 4 < indices.size() * 3)
 		{
-			delete m_pTexture;
-			m_pTexture = nullptr;
+			indices = std::move(stripIndices);
+			topology = PrimitiveTopology::TriangleStrip;
 		}
+
+		return m_Scene.AddMesh(new Mesh(m_pDevice, indices, vertices, topology));
+	}
+
+	VirtualTexture* Renderer::LoadVirtualTexture(const std::string& imagePath)
+	{
+		// The page file is built next to the image, again when it is older than the image
+		const std::string pageFilePath{ imagePath + ".vt" };
+		std::error_code error{};
+		const bool isStale{ !std::filesystem::exists(pageFilePath, error) ||
+			std::filesystem::last_write_time(pageFilePath, error) < std::filesystem::last_write_time(imagePath, error) };
+		if (isStale && !VirtualTexture::BuildPageFile(imagePath, pageFilePath))
+			return nullptr;
+
+		VirtualTexture* pTexture{ VirtualTexture::Open(pageFilePath, m_LoaderPool) };
+		if (pTexture)
+			m_Scene.AddVirtualTexture(pTexture);
+		return pTexture;
+	}
+
+	void Renderer::UpdatePendingTextures()
+	{
+		for (auto it = m_PendingTextures.begin(); it != m_PendingTextures.end();)
+		{
+			if (it->texture.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+
+			const TextureHandle& pTexture{ it->texture.get() };
+			UpdateTextureResidency(pTexture.get());
+			m_Scene.AddTexture(pTexture);
+
+			Material material{ m_Scene.GetEntry(it->entryId).material };
+			material.*(it->map) = pTexture.get();
+			m_Scene.SetMaterial(it->entryId, material);
+			it = m_PendingTextures.erase(it);
+		}
+
+		// Anything the scene dropped may go once the cache is over budget
+		m_pTextureManager->Trim();
+	}
+
+	void Renderer::UpdateDynamicResolution(float frameTime, bool isFrameTimeValid)
+	{
+		// Aspect ratio is kept, the projection does not change with the viewport
+		float scale{ ResolutionGovernor::maxScale };
+		if (!m_Hardware && m_DynamicResolution)
+			scale = isFrameTimeValid ? m_ResolutionGovernor.Update(frameTime) : m_ResolutionGovernor.GetScale();
+
+		m_ViewportWidth = std::clamp(static_cast<int>(m_Width * scale + 0.5f), 1, m_Width);
+		m_ViewportHeight = std::clamp(static_cast<int>(m_Height * scale + 0.5f), 1, m_Height);
+	}
+
+	void Renderer::UpdateTextureResidency(Texture* pTexture) const
+	{
+		// Only the software rasterizer samples the CPU copy
+		if (m_Hardware)
+			pTexture->ReleaseCpuCopy();
+		else if (!pTexture->MakeCpuResident(m_pDevice, m_pDeviceContext))
+			std::cout << "Could not read back texture " << pTexture->GetPath() << ", the software rasterizer shows the placeholder\n";
+	}
+
+	Material Renderer::GetSoftwareMaterial(const Material& material) const
+	{
+		// Maps without a CPU copy would sample black: the placeholder stands in for the diffuse map, the lighting maps are optional
+		const auto isMissing{ [](const Texture* pTexture) { return pTexture && !pTexture->IsCpuResident(); } };
+
+		Material softwareMaterial{ material };
+		if (isMissing(material.pDiffuseMap))
+			softwareMaterial.pDiffuseMap = m_pTextureManager->GetPlaceholder().get();
+		if (isMissing(material.pNormalMap))
+			softwareMaterial.pNormalMap = nullptr;
+		if (isMissing(material.pSpecularMap) || isMissing(material.pGlossMap))
+		{
+			softwareMaterial.pSpecularMap = nullptr;
+			softwareMaterial.pGlossMap = nullptr;
+		}
+		return softwareMaterial;
+	}
+
+	void Renderer::WaitForPendingTextures()
+	{
+		for (const PendingTexture& pending : m_PendingTextures)
+		{
+			pending.texture.wait();
+		}
+		UpdatePendingTextures();
+	}
+
+	void Renderer::SetCameraPose(const Vector3& origin, float yaw, float pitch)
+	{
+		m_Camera.SetPose(origin, yaw, pitch);
 	}
 
 	void Renderer::Update(const Timer* pTimer)
 	{
 		m_Camera.Update(pTimer);
+		Update(pTimer->GetElapsed());
+	}
+
+	void Renderer::Update(float elapsedSec)
+	{
+		UpdatePendingTextures();
+		for (VirtualTexture* pVirtualTexture : m_Scene.GetVirtualTextures())
+		{
+			// New pages sharpen what is on screen
+			if (pVirtualTexture->Update())
+				m_IsFrameDirty = true;
+		}
 
 		if (m_RotationEnabled)
 		{
-			m_Rotation = m_Rotationspeed * pTimer->GetElapsed();
+			m_Rotation = m_Rotationspeed * elapsedSec;
 			m_World *= Matrix::CreateRotationY(m_Rotation);
 		}
 
-		wvpMatrix = m_World * m_Camera.GetViewMatrix() * m_Camera.GetProjectionMatrix();
+		const Matrix viewProjection{ m_Camera.GetViewMatrix() * m_Camera.GetProjectionMatrix() };
+
+		// Same view, same world and same scene as the frame on screen: nothing to draw
+		if (std::memcmp(&viewProjection, &m_ViewProjection, sizeof(Matrix)) != 0 ||
+			std::memcmp(&m_World, &m_DrawnWorld, sizeof(Matrix)) != 0 ||
+			m_Scene.GetRevision() != m_DrawnSceneRevision)
+		{
+			m_IsFrameDirty = true;
+		}
 
-		m_pMesh->SetMatrix(wvpMatrix);
+		// A view that comes to rest gets one last frame at full resolution, the governor may have left it lower
+		if (!m_IsFrameDirty && (m_ViewportWidth != m_Width || m_ViewportHeight != m_Height))
+		{
+			m_ViewportWidth = m_Width;
+			m_ViewportHeight = m_Height;
+			m_IsFrameDirty = true;
+			m_IsIdle = false;
+			return;
+		}
+
+		const bool wasIdle{ m_IsIdle };
+		m_IsIdle = !m_IsFrameDirty;
+		if (m_IsIdle)
+			return;
+
+		m_ViewProjection = viewProjection;
+		m_DrawnWorld = m_World;
+		m_DrawnSceneRevision = m_Scene.GetRevision();
+
+		// The time spent waiting on input says nothing about the cost of a frame
+		UpdateDynamicResolution(elapsedSec, !wasIdle);
+
+		m_Scene.BuildDrawList(m_World, m_Camera.GetViewMatrix());
+	}
+
+	void Renderer::Invalidate()
+	{
+		m_IsFrameDirty = true;
 	}
 
 
 	void Renderer::Render() const
 	{
-		if (!m_IsInitialized)
+		// The presenter thread only blits, frames go on screen from here
+		if (m_pPresenter)
+			m_pPresenter->ShowFrame();
+
+		// An elided frame leaves the last one on screen
+		if (!m_IsInitialized || !m_IsFrameDirty)
 			return;
+		m_IsFrameDirty = false;
 
 		if (m_Hardware)
 		{
@@ -273,6 +540,16 @@ namespace dae {
 	// -------------------
 	void Renderer::ToggleRasterizerMode()
 	{
+		// Headless has no device to switch to
+		if (!m_pWindow)
+			return;
+
+		m_IsFrameDirty = true;
+
+		// The swap chain takes over the window, nothing may still be presenting into it
+		if (m_pPresenter)
+			m_pPresenter->Flush();
+
 		m_Hardware = !m_Hardware;
 
 		if (m_Hardware)
@@ -285,10 +562,20 @@ namespace dae {
 		}
 		std::cout << std::endl;
 		std::cout << "\033[0m";
+
+		if (m_Hardware && m_pCapture)
+			std::cout << "\033[35m" << "**(SOFTWARE) Frame Capture: paused, software rasterizer only\n" << "\033[0m";
+
+		for (const TextureHandle& pTexture : m_Scene.GetTextures())
+		{
+			UpdateTextureResidency(pTexture.get());
+		}
 	}
 
 	void Renderer::ToggleVehicleRotation()
 	{
+		m_IsFrameDirty = true;
+
 		m_RotationEnabled = !m_RotationEnabled;
 
 		std::cout << "\033[33m" << "**(SHARED) Vehicle Rotation: ";
@@ -304,12 +591,50 @@ namespace dae {
 		std::cout << "\033[0m";
 	}
 
+	void Renderer::ToggleFleetInstancing()
+	{
+		m_IsFrameDirty = true;
+
+		m_FleetEnabled = !m_FleetEnabled;
+
+		std::vector<Matrix> instances{};
+		if (m_FleetEnabled)
+		{
+			// Wall of vehicles facing the camera, each one spins in place with m_World
+			instances.reserve(m_FleetColumns * m_FleetRows);
+			for (int row = 0; row < m_FleetRows; ++row)
+			{
+				for (int column = 0; column < m_FleetColumns; ++column)
+				{
+					const float x{ (column - (m_FleetColumns - 1) * 0.5f) * m_FleetSpacing.x };
+					const float y{ (row - (m_FleetRows - 1) * 0.5f) * m_FleetSpacing.y };
+					instances.push_back(Matrix::CreateTranslation(x, y, 0.f));
+				}
+			}
+		}
+		m_Scene.GetMesh(m_VehicleMeshId)->SetInstances(m_pDevice, m_pDeviceContext, instances);
+
+		std::cout << "\033[33m" << "**(SHARED) Fleet Instancing: ";
+
+		if (m_FleetEnabled)
+		{
+			std::cout << "ON (" << instances.size() << " instances)\n";
+		}
+		else
+		{
+			std::cout << "OFF\n";
+		}
+		std::cout << "\033[0m";
+	}
+
 	void Renderer::CycleCullMode()
 	{
 	}
 
 	void Renderer::ToggleUniformClearColor()
 	{
+		m_IsFrameDirty = true;
+
 		m_UniformClearColor = !m_UniformClearColor;
 		std::cout << "\033[33m" << "**(SHARED) Uniform ClearColor: ";
 		if (m_UniformClearColor)
@@ -325,39 +650,111 @@ namespace dae {
 	
 	void Renderer::ToggleFireFX()
 	{
-		if (m_Hardware) {
+		m_IsFrameDirty = true;
 
-			m_FireFX = !m_FireFX;
+		m_FireFX = !m_FireFX;
+		m_Scene.SetEntryVisible(m_FireFXEntryId, m_FireFX);
 
-			std::cout << "\033[32m" << "**(HARDWARE) FireFX: ";
+		std::cout << "\033[33m" << "**(SHARED) FireFX: ";
 
-			if (m_FireFX)
-			{
-				std::cout << "ON\n";
-			}
-			else
-			{
-				std::cout << "OFF\n";
-			}
-			std::cout << "\033[0m";
+		if (m_FireFX)
+		{
+			std::cout << "ON\n";
 		}
+		else
+		{
+			std::cout << "OFF\n";
+		}
+		std::cout << "\033[0m";
 	}
 
 	void Renderer::ToggleTechnique()
 	{
-		m_pMesh->ToggleTechnique();
+		m_IsFrameDirty = true;
+
+		// 3 techniques in the effect file
+		// ---------------------------------
+		// 0 -> PointTechnique
+		// 1 -> LinearTechnique
+		// 2 -> AnisotropicTechnique
+
+		std::string techniqueName;
+		m_TechniqueIdx = (m_TechniqueIdx + 1) % 3;
+		if (m_TechniqueIdx == 0) {
+			techniqueName = "POINT";
+		}
+		else if (m_TechniqueIdx == 1) {
+			techniqueName = "LINEAR";
+		}
+		else {
+			techniqueName = "ANISOTROPIC";
+		}
+		std::cout << "\033[33m";
+		std::cout << "**(SHARED) Sampler Filter = " << techniqueName << std::endl;
+		std::cout << "\033[0m";
+
+		for (Mesh* pMesh : m_Scene.GetMeshes())
+		{
+			pMesh->SetTechniqueIndex(m_TechniqueIdx);
+		}
 	}
 
 	void Renderer::CycleShadingMode()
 	{
+		m_IsFrameDirty = true;
+
+		if (!m_Hardware) {
+			std::string modeName;
+			switch (m_ShadingMode)
+			{
+			case ShadingMode::Combined:
+				m_ShadingMode = ShadingMode::ObservedArea;
+				modeName = "OBSERVED_AREA";
+				break;
+			case ShadingMode::ObservedArea:
+				m_ShadingMode = ShadingMode::Diffuse;
+				modeName = "DIFFUSE";
+				break;
+			case ShadingMode::Diffuse:
+				m_ShadingMode = ShadingMode::Specular;
+				modeName = "SPECULAR";
+				break;
+			case ShadingMode::Specular:
+				m_ShadingMode = ShadingMode::Combined;
+				modeName = "COMBINED";
+				break;
+			}
+
+			std::cout << "\033[35m" << "**(SOFTWARE) Shading Mode = " << modeName << std::endl;
+			std::cout << "\033[0m";
+		}
 	}
 
 	void Renderer::ToggleNormalMap()
 	{
+		m_IsFrameDirty = true;
+
+		if (!m_Hardware) {
+			m_NormalMapEnabled = !m_NormalMapEnabled;
+
+			std::cout << "\033[35m" << "**(SOFTWARE) NormalMap: ";
+
+			if (m_NormalMapEnabled)
+			{
+				std::cout << "ON\n";
+			}
+			else
+			{
+				std::cout << "OFF\n";
+			}
+			std::cout << "\033[0m";
+		}
 	}
 
 	void Renderer::ToggleDepthBufferVisualisation()
 	{
+		m_IsFrameDirty = true;
+
 		if (!m_Hardware) {
 			m_DisplayDepthBuffer = !m_DisplayDepthBuffer;
 
@@ -377,6 +774,8 @@ namespace dae {
 
 	void Renderer::ToggleBoundingBoxVisualisation()
 	{
+		m_IsFrameDirty = true;
+
 		if (!m_Hardware) {
 			m_DisplayBoundingBox = !m_DisplayBoundingBox;
 			std::cout << "\033[35m" << "**(SOFTWARE) Bounding Box Visualisation: ";
@@ -392,6 +791,163 @@ namespace dae {
 		}
 	}
 
+	void Renderer::CyclePresentLatency()
+	{
+		m_IsFrameDirty = true;
+
+		if (!m_Hardware && m_pPresenter) {
+			// The direct path writes the window surface, so the presenter has to be idle first
+			m_pPresenter->Flush();
+			m_PresentLatency = (m_PresentLatency + 1) % (FramePresenter::maxQueuedFrames + 1);
+			if (m_PresentLatency > 0)
+				m_pPresenter->SetQueuedFrames(m_PresentLatency);
+
+			std::cout << "\033[35m" << "**(SOFTWARE) Present Latency: ";
+			if (m_PresentLatency == 0)
+			{
+				std::cout << "0 frames (present on the render thread)\n";
+			}
+			else
+			{
+				std::cout << m_PresentLatency << (m_PresentLatency == 1 ? " frame" : " frames") << " (presenter thread)\n";
+			}
+			std::cout << "\033[0m";
+		}
+	}
+
+	void Renderer::ToggleDynamicResolution()
+	{
+		m_IsFrameDirty = true;
+
+		if (!m_Hardware) {
+			m_DynamicResolution = !m_DynamicResolution;
+			m_ResolutionGovernor.Reset();
+
+			std::cout << "\033[35m" << "**(SOFTWARE) Dynamic Resolution: ";
+			if (m_DynamicResolution)
+			{
+				std::cout << "ON (target " << m_ResolutionGovernor.GetTargetFrameTime() * 1000.f << " ms)\n";
+			}
+			else
+			{
+				std::cout << "OFF\n";
+			}
+			std::cout << "\033[0m";
+		}
+	}
+
+	void Renderer::ToggleVirtualTexturing()
+	{
+		m_IsFrameDirty = true;
+
+		if (!m_Hardware) {
+			// The page file is built from the diffuse map on first use, that takes a moment
+			if (!m_pVehicleVirtualDiffuse)
+				m_pVehicleVirtualDiffuse = LoadVirtualTexture("resources/vehicle_diffuse.png");
+
+			std::cout << "\033[35m" << "**(SOFTWARE) Virtual Texturing: ";
+			if (!m_pVehicleVirtualDiffuse)
+			{
+				std::cout << "could not open the page file\n" << "\033[0m";
+				return;
+			}
+
+			m_VirtualTexturing = !m_VirtualTexturing;
+
+			Material material{ m_Scene.GetEntry(m_VehicleEntryId).material };
+			material.pVirtualDiffuseMap = m_VirtualTexturing ? m_pVehicleVirtualDiffuse : nullptr;
+			m_Scene.SetMaterial(m_VehicleEntryId, material);
+
+			if (m_VirtualTexturing)
+			{
+				std::cout << "ON (vehicle diffuse paged from resources/vehicle_diffuse.png.vt)\n";
+			}
+			else
+			{
+				std::cout << "OFF\n";
+			}
+			std::cout << "\033[0m";
+		}
+	}
+
+	void Renderer::ToggleFrameCapture()
+	{
+		m_IsFrameDirty = true;
+
+		if (!m_Hardware) {
+			// Numbered images, frames here come at the render rate and not at all while the view is idle
+			if (m_pCapture)
+				StopCapture();
+			else
+				StartCapture("capture.png", 60.f);
+		}
+		else
+		{
+			std::cout << "\033[32m" << "**(HARDWARE) Frame Capture: software rasterizer only\n" << "\033[0m";
+		}
+	}
+
+	bool Renderer::StartCapture(const std::string& path, float frameRate)
+	{
+		StopCapture();
+
+		// A stream plays at the declared rate, only headless runs draw every frame at a fixed time step
+		if (m_pWindow && FrameCapture::GetFormat(path) != CaptureFormat::Png)
+		{
+			std::cout << "\033[35m" << "**(SOFTWARE) Frame Capture: " << path << " needs --headless, use a .png pattern here\n" << "\033[0m";
+			return false;
+		}
+
+		m_pCapture = new FrameCapture(path, m_Width, m_Height, frameRate);
+		if (!m_pCapture->IsOpen())
+		{
+			std::cout << "\033[35m" << "**(SOFTWARE) Frame Capture: could not open " << path << "\n" << "\033[0m";
+			delete m_pCapture;
+			m_pCapture = nullptr;
+			return false;
+		}
+
+		std::cout << "\033[35m" << "**(SOFTWARE) Frame Capture: ON (" << m_pCapture->GetPath() << ")\n" << "\033[0m";
+		return true;
+	}
+
+	void Renderer::StopCapture()
+	{
+		if (!m_pCapture)
+			return;
+
+		// Waits for the writer to finish the queued frames
+		m_pCapture->Close();
+		const int submittedFrames{ m_pCapture->GetSubmittedFrames() };
+		const int droppedFrames{ m_pCapture->GetDroppedFrames() };
+		const int failedFrames{ m_pCapture->GetFailedFrames() };
+
+		delete m_pCapture;
+		m_pCapture = nullptr;
+
+		std::cout << "\033[35m" << "**(SOFTWARE) Frame Capture: OFF (" << submittedFrames - droppedFrames - failedFrames << " frames written, "
+			<< droppedFrames << " dropped, " << failedFrames << " failed to write)\n" << "\033[0m";
+	}
+
+	void Renderer::ToggleOrderIndependentTransparency()
+	{
+		m_IsFrameDirty = true;
+
+		if (!m_Hardware) {
+			m_OrderIndependentTransparency = !m_OrderIndependentTransparency;
+			std::cout << "\033[35m" << "**(SOFTWARE) Order Independent Transparency: ";
+			if (m_OrderIndependentTransparency)
+			{
+				std::cout << "ON (weighted blended)\n";
+			}
+			else
+			{
+				std::cout << "OFF (sorted)\n";
+			}
+			std::cout << "\033[0m";
+		}
+	}
+
 	void Renderer::DrawBoundingBox(int minX, int minY, int maxX, int maxY, uint32_t* framebuffer, int width, int height, uint32_t color) const
 	{
 		// Top
@@ -419,230 +975,720 @@ namespace dae {
 	void Renderer::RenderSoftware() const
 	{
 		//@START
+		// Pipelined: the next free presenter frame, otherwise the back buffer (which may be the window itself)
+		const bool isPipelined{ m_pPresenter && m_PresentLatency > 0 };
+		SDL_Surface* pFrame{ isPipelined ? m_pPresenter->AcquireFrame() : m_pBackBuffer };
+
+		// Below full resolution the frame is rasterized in the top left of the scaled buffer and stretched at present.
+		// Rows keep the full width as stride, so only the viewport changes
+		const bool isScaled{ m_pScaledBuffer && (m_ViewportWidth != m_Width || m_ViewportHeight != m_Height) };
+		m_pRenderTarget = isScaled ? m_pScaledBuffer : pFrame;
+
 		//Lock BackBuffer
-		SDL_LockSurface(m_pBackBuffer);
+		SDL_LockSurface(m_pRenderTarget);
+		m_pRenderTargetPixels = static_cast<uint32_t*>(m_pRenderTarget->pixels);
+
+		const SDL_PixelFormat& format{ *m_pRenderTarget->format };
+		m_PixelPacking.redShift = format.Rshift;
+		m_PixelPacking.greenShift = format.Gshift;
+		m_PixelPacking.blueShift = format.Bshift;
+		m_PixelPacking.alphaMask = format.Amask;
 
 		//Clear BackBuffer
 		if (m_UniformClearColor) {
-			Uint32 clearColor = SDL_MapRGB(m_pBackBuffer->format, 39, 39, 39);
-			SDL_FillRect(m_pBackBuffer, nullptr, clearColor);
+			Uint32 clearColor = m_PixelPacking.Pack(39, 39, 39);
+			SDL_FillRect(m_pRenderTarget, nullptr, clearColor);
 		}
 		else {
-			Uint32 clearColor = SDL_MapRGB(m_pBackBuffer->format, 100, 100, 100);
-			SDL_FillRect(m_pBackBuffer, nullptr, clearColor);
+			Uint32 clearColor = m_PixelPacking.Pack(100, 100, 100);
+			SDL_FillRect(m_pRenderTarget, nullptr, clearColor);
+		}
+
+		for (size_t i = 0; i < static_cast<size_t>(m_Width) * m_ViewportHeight; ++i) {
+			m_pDepthBufferPixels[i] = std::numeric_limits<float>::max();
 		}
 
-		// Set world space coordinates to NDC
-		VertexTransformationFunction(m_pMesh);
+		for (const DrawItem& item : m_Scene.GetDrawList())
+		{
+			const SceneEntry& entry{ m_Scene.GetEntry(item.entryId) };
+
+			// The depth visualisation only shows opaque geometry
+			if (entry.material.isTransparent && m_DisplayDepthBuffer)
+				continue;
+
+			Mesh* pMesh{ m_Scene.GetMesh(entry.meshId) };
 
-		// Render Mesh
-		RenderSoftwareMesh(m_pMesh);
+			// Set world space coordinates to NDC
+			VertexTransformationFunction(pMesh, item.world);
+
+			// Render Mesh
+			RenderSoftwareMesh(pMesh, GetSoftwareMaterial(entry.material));
+		}
 		
+		if (m_OrderIndependentTransparency && !m_DisplayDepthBuffer)
+			ResolveTransparency();
+
 		//@END
 		//Update SDL Surface
-		SDL_UnlockSurface(m_pBackBuffer);
-		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+		SDL_UnlockSurface(m_pRenderTarget);
+		if (isScaled)
+		{
+			SDL_Rect viewport{ 0, 0, m_ViewportWidth, m_ViewportHeight };
+			SDL_BlitScaled(m_pScaledBuffer, &viewport, pFrame, nullptr);
+		}
+
+		if (m_pCapture)
+			m_pCapture->Submit(pFrame);
+
+		// Headless, the frame stays in the back buffer
+		if (!m_pWindow)
+			return;
+
+		if (isPipelined)
+		{
+			m_pPresenter->SubmitFrame(pFrame);
+			return;
+		}
+
+		if (!m_RenderToWindow)
+			SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
 		SDL_UpdateWindowSurface(m_pWindow);
 	}
 
-	void Renderer::VertexTransformationFunction(Mesh* mesh) const
+	namespace
 	{
-		std::vector<Vertex_PosCol>& vertices{ mesh->GetVertices() };
-		std::vector<Vertex_Out>&	vertices_out{ mesh->GetVerticesOut() };
+		// Matrix elements broadcast over 4 lanes, so 4 vertices are transformed at once (SoA)
+		struct MatrixSoA
+		{
+			__m128 m[4][4];
 
-		vertices_out.clear();
-		vertices_out.reserve(vertices.size());
+			explicit MatrixSoA(const Matrix& matrix)
+			{
+				for (int r{ 0 }; r < 4; ++r)
+				{
+					for (int c{ 0 }; c < 4; ++c)
+					{
+						m[r][c] = _mm_set1_ps(matrix[r][c]);
+					}
+				}
+			}
 
-		for (auto& vertex : vertices)
+			// Row vector * matrix, w = 1
+			void TransformPoint(__m128 x, __m128 y, __m128 z, __m128 out[4]) const
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					out[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][c]), _mm_mul_ps(y, m[1][c])),
+						_mm_add_ps(_mm_mul_ps(z, m[2][c]), m[3][c]));
+				}
+			}
+
+			// Row vector * matrix, w = 0
+			void TransformVector(__m128 x, __m128 y, __m128 z, __m128 out[3]) const
+			{
+				for (int c{ 0 }; c < 3; ++c)
+				{
+					out[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][c]), _mm_mul_ps(y, m[1][c])), _mm_mul_ps(z, m[2][c]));
+				}
+			}
+		};
+
+		// Transforms all vertices of one instance in batches of 4.
+		// Returns false when every vertex lies outside the same clip plane (instance can be skipped)
+		bool TransformVertexBatch(const Vertex_PosCol* pVertices, size_t numVertices, const Matrix& world, const Matrix& worldViewProjection, const Vector3& cameraOrigin, Vertex_Out* pOut)
 		{
-			Vertex_Out outVertex{ 
-				wvpMatrix.TransformPoint({vertex.position, 1.f}),
-				vertex.color,
-				vertex.uv,
-				m_World.TransformVector(vertex.normal),
-				m_World.TransformVector(vertex.tangent),
-				m_World.TransformVector(vertex.viewDirection)
-			};
+			const MatrixSoA worldSoA{ world };
+			const MatrixSoA wvpSoA{ worldViewProjection };
+			const __m128 one{ _mm_set1_ps(1.f) };
+			const __m128 zero{ _mm_setzero_ps() };
 
-			// World Space
-			Vector4 worldSpace{
-				vertex.position.x,
-				vertex.position.y,
-				vertex.position.z,
-				1.f
-			};
+			// Per clip plane: lanes that had every vertex outside so far
+			int outsideAll[6]{ 0xF, 0xF, 0xF, 0xF, 0xF, 0xF };
 
-			// View Space
-			Vector4 viewSpace{ m_Camera.GetViewMatrix().TransformPoint(m_World.TransformPoint(worldSpace))};
+			alignas(16) float position[4][4];
+			alignas(16) float normal[3][4];
+			alignas(16) float tangent[3][4];
+			alignas(16) float viewDirection[3][4];
+			const __m128 camera[3]{ _mm_set1_ps(cameraOrigin.x), _mm_set1_ps(cameraOrigin.y), _mm_set1_ps(cameraOrigin.z) };
 
-			// Projection Space
-			Vector4 projected{ m_Camera.GetProjectionMatrix().TransformPoint(viewSpace)};
+			for (size_t base = 0; base < numVertices; base += 4)
+			{
+				const size_t count{ std::min<size_t>(4, numVertices - base) };
+
+				// Gather, the tail repeats the last vertex
+				const Vertex_PosCol& v0{ pVertices[base] };
+				const Vertex_PosCol& v1{ pVertices[base + std::min<size_t>(1, count - 1)] };
+				const Vertex_PosCol& v2{ pVertices[base + std::min<size_t>(2, count - 1)] };
+				const Vertex_PosCol& v3{ pVertices[base + std::min<size_t>(3, count - 1)] };
+
+				const __m128 positionX{ _mm_setr_ps(v0.position.x, v1.position.x, v2.position.x, v3.position.x) };
+				const __m128 positionY{ _mm_setr_ps(v0.position.y, v1.position.y, v2.position.y, v3.position.y) };
+				const __m128 positionZ{ _mm_setr_ps(v0.position.z, v1.position.z, v2.position.z, v3.position.z) };
+
+				__m128 clip[4];
+				wvpSoA.TransformPoint(positionX, positionY, positionZ, clip);
+
+				// Camera to vertex, normalized per pixel
+				__m128 worldPosition[4];
+				worldSoA.TransformPoint(positionX, positionY, positionZ, worldPosition);
+
+				__m128 worldNormal[3];
+				worldSoA.TransformVector(
+					_mm_setr_ps(v0.normal.x, v1.normal.x, v2.normal.x, v3.normal.x),
+					_mm_setr_ps(v0.normal.y, v1.normal.y, v2.normal.y, v3.normal.y),
+					_mm_setr_ps(v0.normal.z, v1.normal.z, v2.normal.z, v3.normal.z),
+					worldNormal);
+
+				__m128 worldTangent[3];
+				worldSoA.TransformVector(
+					_mm_setr_ps(v0.tangent.x, v1.tangent.x, v2.tangent.x, v3.tangent.x),
+					_mm_setr_ps(v0.tangent.y, v1.tangent.y, v2.tangent.y, v3.tangent.y),
+					_mm_setr_ps(v0.tangent.z, v1.tangent.z, v2.tangent.z, v3.tangent.z),
+					worldTangent);
+
+				// Clip plane tests (x, y in [-w, w], z in [0, w])
+				const __m128 negW{ _mm_sub_ps(zero, clip[3]) };
+				outsideAll[0] &= _mm_movemask_ps(_mm_cmplt_ps(clip[0], negW));
+				outsideAll[1] &= _mm_movemask_ps(_mm_cmpgt_ps(clip[0], clip[3]));
+				outsideAll[2] &= _mm_movemask_ps(_mm_cmplt_ps(clip[1], negW));
+				outsideAll[3] &= _mm_movemask_ps(_mm_cmpgt_ps(clip[1], clip[3]));
+				outsideAll[4] &= _mm_movemask_ps(_mm_cmplt_ps(clip[2], zero));
+				outsideAll[5] &= _mm_movemask_ps(_mm_cmpgt_ps(clip[2], clip[3]));
+
+				// Perspective Division, w is kept for perspective correct interpolation
+				const __m128 invW{ _mm_div_ps(one, clip[3]) };
+				_mm_store_ps(position[0], _mm_mul_ps(clip[0], invW));
+				_mm_store_ps(position[1], _mm_mul_ps(clip[1], invW));
+				_mm_store_ps(position[2], _mm_mul_ps(clip[2], invW));
+				_mm_store_ps(position[3], clip[3]);
+
+				for (int c{ 0 }; c < 3; ++c)
+				{
+					_mm_store_ps(normal[c], worldNormal[c]);
+					_mm_store_ps(tangent[c], worldTangent[c]);
+					_mm_store_ps(viewDirection[c], _mm_sub_ps(worldPosition[c], camera[c]));
+				}
 
-			// Perspective Division
-			outVertex.position.x /= projected.w;
-			outVertex.position.y /= projected.w;
-			outVertex.position.z /= projected.w;
+				// NDC Space
+				for (size_t k = 0; k < count; ++k)
+				{
+					const Vertex_PosCol& vertex{ pVertices[base + k] };
+					Vertex_Out& outVertex{ pOut[base + k] };
+
+					outVertex.position = { position[0][k], position[1][k], position[2][k], position[3][k] };
+					outVertex.color = vertex.color;
+					outVertex.uv = vertex.uv;
+					outVertex.normal = { normal[0][k], normal[1][k], normal[2][k] };
+					outVertex.tangent = { tangent[0][k], tangent[1][k], tangent[2][k] };
+					outVertex.viewDirection = { viewDirection[0][k], viewDirection[1][k], viewDirection[2][k] };
+				}
+			}
 
-			// NDC Space
-			vertices_out.emplace_back(outVertex);
+			for (int plane{ 0 }; plane < 6; ++plane)
+			{
+				if (outsideAll[plane] == 0xF)
+					return false;
+			}
+			return true;
 		}
-	}
 
-	void Renderer::RenderSoftwareMesh(Mesh* mesh) const
-	{
-		std::vector<uint32_t>&		indices{ mesh->GetIndices() };
-		std::vector<Vertex_Out>&	vertices_NDC{ mesh->GetVerticesOut() };
+		// Attribute / w over the screen: value at the first vertex plus the screen space gradients
+		struct VectorPlane
+		{
+			Vector3 origin{};
+			Vector3 dx{};
+			Vector3 dy{};
 
-		PrimitiveTopology topology{ mesh->GetTopology() };
+			Vector3 At(const Vector2& offset) const { return origin + dx * offset.x + dy * offset.y; }
+		};
 
-		for (size_t i = 0; i < m_Width * m_Height; ++i) {
-			m_pDepthBufferPixels[i] = std::numeric_limits<float>::max();
+		// Source over on packed pixels, 4 at a time: dst = (src * a + dst * (256 - a)) >> 8 per byte.
+		// Every byte gets the same weight, so the surface's channel order does not matter
+		inline __m128i BlendSourceOver4(__m128i source, __m128i destination, __m128i alpha)
+		{
+			const __m128i zero{ _mm_setzero_si128() };
+			const __m128i full{ _mm_set1_epi16(256) };
+
+			// 32 bit alpha per pixel -> the same 16 bit weight for each of its 4 channels
+			const __m128i alphaPairs{ _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16)) };
+			const __m128i alphaLow{ _mm_unpacklo_epi32(alphaPairs, alphaPairs) };
+			const __m128i alphaHigh{ _mm_unpackhi_epi32(alphaPairs, alphaPairs) };
+
+			const __m128i low{ _mm_srli_epi16(_mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpacklo_epi8(source, zero), alphaLow),
+				_mm_mullo_epi16(_mm_unpacklo_epi8(destination, zero), _mm_sub_epi16(full, alphaLow))), 8) };
+			const __m128i high{ _mm_srli_epi16(_mm_add_epi16(
+				_mm_mullo_epi16(_mm_unpackhi_epi8(source, zero), alphaHigh),
+				_mm_mullo_epi16(_mm_unpackhi_epi8(destination, zero), _mm_sub_epi16(full, alphaHigh))), 8) };
+			return _mm_packus_epi16(low, high);
 		}
 
-		// Rasterization
-		uint16_t size = indices.size() - (topology == PrimitiveTopology::TriangleList ? 0 : 2);
+		// Float colors -> packed pixels, 4 lanes at once: scaled down like ColorRGB::MaxToOne,
+		// then truncated (like static_cast<uint8_t>) and saturated to 8 bit
+		inline __m128i PackColors4(__m128 r, __m128 g, __m128 b, const PixelPacking& packing)
+		{
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 maxByte{ _mm_set1_ps(255.f) };
+			const __m128 scale{ _mm_div_ps(maxByte, _mm_max_ps(_mm_max_ps(_mm_max_ps(r, g), b), _mm_set1_ps(1.f))) };
+
+			auto toChannel = [&](__m128 value, int shift)
+				{
+					const __m128i channel{ _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(value, scale), zero), maxByte)) };
+					return _mm_sll_epi32(channel, _mm_cvtsi32_si128(shift));
+				};
+
+			return _mm_or_si128(_mm_or_si128(toChannel(r, packing.redShift), toChannel(g, packing.greenShift)),
+				_mm_or_si128(toChannel(b, packing.blueShift), _mm_set1_epi32(static_cast<int>(packing.alphaMask))));
+		}
+
+		// Opaque packet: packed 4 at a time and scattered to the pixels they cover
+		void WritePacket(const FragmentPacket& packet, const ShadedPacket& shaded, const PixelPacking& packing, uint32_t* pPixels)
+		{
+			for (int first{ 0 }; first < packet.count; first += 4)
+			{
+				const int lanes{ std::min(4, packet.count - first) };
+
+				alignas(16) uint32_t pixels[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(pixels),
+					PackColors4(_mm_load_ps(shaded.r + first), _mm_load_ps(shaded.g + first), _mm_load_ps(shaded.b + first), packing));
+
+				for (int k{ 0 }; k < lanes; ++k)
+				{
+					pPixels[packet.pixelIndex[first + k]] = pixels[k];
+				}
+			}
+		}
 
-		for (size_t i = 0; i < size; i += (topology == PrimitiveTopology::TriangleList ? 3 : 1))
+		// Packs the shaded colors in the surface's layout and blends them over the pixels they cover
+		void BlendPacket(const FragmentPacket& packet, const ShadedPacket& shaded, const PixelPacking& packing, uint32_t* pPixels)
 		{
-			// Vertices
-			Vector2 v0{ vertices_NDC[indices[i]].position.x,	 vertices_NDC[indices[i]].position.y };
-			Vector2 v1{};
-			Vector2 v2{};
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
 
-			// z positions
-			float z0 = vertices_NDC[indices[i]].position.z;
-			float z1{};
-			float z2{};
+			for (int first{ 0 }; first < packet.count; first += 4)
+			{
+				const int lanes{ std::min(4, packet.count - first) };
 
-			// w positions
-			float zw0 = vertices_NDC[indices[i]].position.w;
-			float zw1{};
-			float zw2{};
+				// Straight alpha, colors are clamped rather than scaled
+				auto clamped = [&](const float* pValues)
+					{
+						return _mm_min_ps(_mm_max_ps(_mm_load_ps(pValues + first), zero), one);
+					};
 
-			if (topology == PrimitiveTopology::TriangleStrip && i % 2 != 0) {
-				v1 = { vertices_NDC[indices[i + 2]].position.x, vertices_NDC[indices[i + 2]].position.y };
-				v2 = { vertices_NDC[indices[i + 1]].position.x, vertices_NDC[indices[i + 1]].position.y };
+				const __m128i source{ PackColors4(clamped(shaded.r), clamped(shaded.g), clamped(shaded.b), packing) };
+				const __m128i alpha{ _mm_cvtps_epi32(_mm_mul_ps(clamped(shaded.a), _mm_set1_ps(256.f))) };
 
-				z1 = vertices_NDC[indices[i + 2]].position.z;
-				z2 = vertices_NDC[indices[i + 1]].position.z;
+				// Fragments of a packet are scattered over the surface
+				alignas(16) uint32_t pixels[4]{};
+				for (int k{ 0 }; k < lanes; ++k)
+				{
+					pixels[k] = pPixels[packet.pixelIndex[first + k]];
+				}
+
+				_mm_store_si128(reinterpret_cast<__m128i*>(pixels), BlendSourceOver4(source, _mm_load_si128(reinterpret_cast<const __m128i*>(pixels)), alpha));
 
-				zw1 = vertices_NDC[indices[i + 2]].position.w;
-				zw2 = vertices_NDC[indices[i + 1]].position.w;
+				for (int k{ 0 }; k < lanes; ++k)
+				{
+					pPixels[packet.pixelIndex[first + k]] = pixels[k];
+				}
 			}
-			else {
-				v1 = { vertices_NDC[indices[i + 1]].position.x, vertices_NDC[indices[i + 1]].position.y };
-				v2 = { vertices_NDC[indices[i + 2]].position.x, vertices_NDC[indices[i + 2]].position.y };
+		}
 
-				z1 = vertices_NDC[indices[i + 1]].position.z;
-				z2 = vertices_NDC[indices[i + 2]].position.z;
+		// Weighted blended OIT (McGuire & Bavoil): weight falls off with view depth so near layers dominate
+		void AccumulatePacket(const FragmentPacket& packet, const ShadedPacket& shaded, float* pAccumulation, float* pRevealage)
+		{
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ _mm_set1_ps(1.f) };
 
-				zw1 = vertices_NDC[indices[i + 1]].position.w;
-				zw2 = vertices_NDC[indices[i + 2]].position.w;
+			for (int first{ 0 }; first < packet.count; first += 4)
+			{
+				const int lanes{ std::min(4, packet.count - first) };
+
+				const __m128 alpha{ _mm_min_ps(_mm_max_ps(_mm_load_ps(shaded.a + first), zero), one) };
+
+				// w = clamp(10 / (1e-5 + (z / 5)^2 + (z / 200)^6), 1e-2, 3e3) * alpha
+				const __m128 depth{ _mm_load_ps(packet.depth + first) };
+				const __m128 near{ _mm_mul_ps(depth, _mm_set1_ps(1.f / 5.f)) };
+				const __m128 far{ _mm_mul_ps(depth, _mm_set1_ps(1.f / 200.f)) };
+				const __m128 far2{ _mm_mul_ps(far, far) };
+				const __m128 falloff{ _mm_add_ps(_mm_add_ps(_mm_set1_ps(1e-5f), _mm_mul_ps(near, near)), _mm_mul_ps(_mm_mul_ps(far2, far2), far2)) };
+				const __m128 weight{ _mm_mul_ps(alpha, _mm_min_ps(_mm_max_ps(_mm_div_ps(_mm_set1_ps(10.f), falloff), _mm_set1_ps(1e-2f)), _mm_set1_ps(3e3f))) };
+
+				// SoA -> one (r, g, b, a) * weight record per fragment
+				__m128 records[4]{
+					_mm_mul_ps(_mm_load_ps(shaded.r + first), weight),
+					_mm_mul_ps(_mm_load_ps(shaded.g + first), weight),
+					_mm_mul_ps(_mm_load_ps(shaded.b + first), weight),
+					weight };
+				_MM_TRANSPOSE4_PS(records[0], records[1], records[2], records[3]);
+
+				alignas(16) float alphaLanes[4];
+				_mm_store_ps(alphaLanes, alpha);
+				for (int k{ 0 }; k < lanes; ++k)
+				{
+					const int pixelIndex{ packet.pixelIndex[first + k] };
+					float* pRecord{ pAccumulation + 4 * static_cast<size_t>(pixelIndex) };
+					_mm_store_ps(pRecord, _mm_add_ps(_mm_load_ps(pRecord), records[k]));
+					pRevealage[pixelIndex] *= 1.f - alphaLanes[k];
+				}
 			}
+		}
 
-			// NDC Coordinates
-			Vector2 A{ ((v0.x + 1) / 2) * m_Width, ((1 - v0.y) / 2) * m_Height };
-			Vector2 B{ ((v1.x + 1) / 2) * m_Width, ((1 - v1.y) / 2) * m_Height };
-			Vector2 C{ ((v2.x + 1) / 2) * m_Width, ((1 - v2.y) / 2) * m_Height };
+		// Calls function with std::integral_constant<T, value> for the value that matches, so a runtime state becomes a template argument
+		template<typename T, T... values, typename Function>
+		void Dispatch(T value, Function&& function)
+		{
+			((value == values ? (function(std::integral_constant<T, values>{}), true) : false) || ...);
+		}
+	}
 
-			// Edges
-			Vector2 edge0 = B - A;
-			Vector2 edge1 = C - B;
-			Vector2 edge2 = A - C;
+	void Renderer::VertexTransformationFunction(Mesh* mesh, const Matrix& world) const
+	{
+		const std::vector<Vertex_PosCol>&	vertices{ mesh->GetVertices() };
+		std::vector<Vertex_Out>&			vertices_out{ mesh->GetVerticesOut() };
+		const std::vector<Matrix>&			instances{ mesh->GetInstances() };
+		std::vector<bool>&					instancesVisible{ mesh->GetInstancesVisible() };
 
-			// Bounding box
-			int minX = std::max(0, static_cast<int>(std::floor(std::min({ A.x, B.x, C.x }))));
-			int minY = std::max(0, static_cast<int>(std::floor(std::min({ A.y, B.y, C.y }))));
+		// All instances share the vertex data, their output is stored back to back
+		const size_t numVertices{ vertices.size() };
+		vertices_out.resize(numVertices * instances.size());
+		instancesVisible.assign(instances.size(), false);
 
-			int maxX = std::min(m_Width - 1, static_cast<int>(std::ceil(std::max({ A.x, B.x, C.x }))));
-			int maxY = std::min(m_Height - 1, static_cast<int>(std::ceil(std::max({ A.y, B.y, C.y }))));
+		for (size_t instance = 0; instance < instances.size(); ++instance)
+		{
+			const Matrix instanceWorld{ world * instances[instance] };
+			const Matrix worldViewProjection{ instanceWorld * m_ViewProjection };
 
-			if (m_DisplayBoundingBox)
+			instancesVisible[instance] = TransformVertexBatch(vertices.data(), numVertices, instanceWorld, worldViewProjection, m_Camera.origin, &vertices_out[instance * numVertices]);
+		}
+	}
+
+	void Renderer::RenderSoftwareMesh(Mesh* mesh, const Material& material) const
+	{
+		// Raster state is picked once per draw, the shading state travels with the packets
+		Dispatch<PrimitiveTopology, PrimitiveTopology::TriangleList, PrimitiveTopology::TriangleStrip>(mesh->GetTopology(), [&](auto topology)
 			{
-				Uint32 boundingColor = SDL_MapRGB(m_pBackBuffer->format, 100, 000, 000);
-				DrawBoundingBox(minX, minY, maxX, maxY, m_pBackBufferPixels, m_Width, m_Height, boundingColor);
-			}
+				if (material.isTransparent)
+				{
+					if (m_OrderIndependentTransparency)
+						RasterizeMesh<RasterState<decltype(topology)::value, false, BlendMode::WeightedBlended>>(mesh, material);
+					else
+						RasterizeMesh<RasterState<decltype(topology)::value, false, BlendMode::SourceOver>>(mesh, material);
+					return;
+				}
 
-			for (int px{ minX }; px < maxX; ++px)
+				Dispatch<bool, false, true>(m_DisplayDepthBuffer, [&](auto displayDepth)
+					{
+						RasterizeMesh<RasterState<decltype(topology)::value, decltype(displayDepth)::value, BlendMode::Opaque>>(mesh, material);
+					});
+			});
+	}
+
+	template<typename State>
+	void Renderer::RasterizeMesh(Mesh* mesh, const Material& material) const
+	{
+		constexpr PrimitiveTopology topology{ State::topology };
+
+		// Shader kernel for this draw's state and its constants, lod is filled in per triangle
+		ShaderContext context{};
+		context.pMaterial = &material;
+		context.filter = static_cast<SamplerFilter>(m_TechniqueIdx);
+		context.shadingMode = m_ShadingMode;
+		context.useNormalMap = m_NormalMapEnabled;
+		const ShadeFunction shade{ m_PixelShaders.Get(material.pixelShaderId)(context) };
+		FragmentPacket packet{};
+
+		std::vector<uint32_t>&		indices{ mesh->GetIndices() };
+		std::vector<Vertex_Out>&	vertices_NDC{ mesh->GetVerticesOut() };
+		const std::vector<bool>&	instancesVisible{ mesh->GetInstancesVisible() };
+
+		constexpr bool isStrip{ topology == PrimitiveTopology::TriangleStrip };
+		constexpr size_t step{ isStrip ? 1 : 3 };
+
+		if (indices.size() < 3)
+			return;
+
+		// Rasterization
+		const size_t size = indices.size() - (isStrip ? 2 : 0);
+		const size_t numVertices{ mesh->GetVertices().size() };
+
+		// Every instance goes through the same depth buffer in one pass
+		for (size_t instance = 0; instance < instancesVisible.size(); ++instance)
+		{
+			if (!instancesVisible[instance])
+				continue;
+
+			const Vertex_Out* pVertices{ &vertices_NDC[instance * numVertices] };
+
+			for (size_t i = 0; i < size; i += step)
 			{
-				for (int py{ minY }; py < maxY; ++py)
+				// Odd strip triangles are flipped to keep the winding, resolved once per triangle
+				uint32_t index0{ indices[i] };
+				uint32_t index1{ indices[i + 1] };
+				uint32_t index2{ indices[i + 2] };
+
+				if constexpr (isStrip)
+				{
+					// Degenerate triangles only join strips
+					if (index0 == index1 || index1 == index2 || index0 == index2)
+						continue;
+
+					if (i % 2 != 0)
+						std::swap(index1, index2);
+				}
+
+				const Vertex_Out& vertex0{ pVertices[index0] };
+				const Vertex_Out& vertex1{ pVertices[index1] };
+				const Vertex_Out& vertex2{ pVertices[index2] };
+
+				// Vertices
+				Vector2 v0{ vertex0.position.x, vertex0.position.y };
+				Vector2 v1{ vertex1.position.x, vertex1.position.y };
+				Vector2 v2{ vertex2.position.x, vertex2.position.y };
+
+				// z positions
+				float z0 = vertex0.position.z;
+				float z1 = vertex1.position.z;
+				float z2 = vertex2.position.z;
+
+				// w positions
+				float zw0 = vertex0.position.w;
+				float zw1 = vertex1.position.w;
+				float zw2 = vertex2.position.w;
+
+				// NDC Coordinates
+				Vector2 A{ ((v0.x + 1) / 2) * m_ViewportWidth, ((1 - v0.y) / 2) * m_ViewportHeight };
+				Vector2 B{ ((v1.x + 1) / 2) * m_ViewportWidth, ((1 - v1.y) / 2) * m_ViewportHeight };
+				Vector2 C{ ((v2.x + 1) / 2) * m_ViewportWidth, ((1 - v2.y) / 2) * m_ViewportHeight };
+
+				// Edges
+				Vector2 edge0 = B - A;
+				Vector2 edge1 = C - B;
+				Vector2 edge2 = A - C;
+
+				// Bounding box
+				int minX = std::max(0, static_cast<int>(std::floor(std::min({ A.x, B.x, C.x }))));
+				int minY = std::max(0, static_cast<int>(std::floor(std::min({ A.y, B.y, C.y }))));
+
+				int maxX = std::min(m_ViewportWidth - 1, static_cast<int>(std::ceil(std::max({ A.x, B.x, C.x }))));
+				int maxY = std::min(m_ViewportHeight - 1, static_cast<int>(std::ceil(std::max({ A.y, B.y, C.y }))));
+
+				if (m_DisplayBoundingBox)
 				{
-					ColorRGB finalColor{ colors::Black };
-					Vector2 P{ px + 0.5f, py + 0.5f };
+					Uint32 boundingColor = m_PixelPacking.Pack(100, 000, 000);
+					DrawBoundingBox(minX, minY, maxX, maxY, m_pRenderTargetPixels, m_Width, m_Height, boundingColor);
+				}
+
+				// Perspective divided uv's, constant over the triangle
+				const Vector2 uv0{ vertex0.uv / zw0 };
+				const Vector2 uv1{ vertex1.uv / zw1 };
+				const Vector2 uv2{ vertex2.uv / zw2 };
 
-					// Direction from NDC to P(ixel Point)
-					Vector2 AP = P - A;
-					Vector2 BP = P - B;
-					Vector2 CP = P - C;
+				// Mip level from the uv derivatives at the centroid, uv/w and 1/w are linear in screen space
+				const float doubleArea{ Vector2::Cross(B - A, C - A) };
+				if (doubleArea == 0.f)
+					continue;
 
-					// Barycentric weights
-					float w0 = (Vector2::Cross(edge1, BP));
-					float w1 = (Vector2::Cross(edge2, CP));
-					float w2 = (Vector2::Cross(edge0, AP));
+				const float invDoubleArea{ 1.f / doubleArea };
+				auto screenGradient = [&](float f0, float f1, float f2)
+					{
+						return Vector2{
+							((f1 - f0) * (C.y - A.y) - (f2 - f0) * (B.y - A.y)) * invDoubleArea,
+							((f2 - f0) * (B.x - A.x) - (f1 - f0) * (C.x - A.x)) * invDoubleArea };
+					};
+
+				const Vector2 dInvWdxy{ screenGradient(1.f / zw0, 1.f / zw1, 1.f / zw2) };
+				const Vector2 dUdxy{ screenGradient(uv0.x, uv1.x, uv2.x) };
+				const Vector2 dVdxy{ screenGradient(uv0.y, uv1.y, uv2.y) };
 
-					// Total Triangle Area 
-					float total = w0 + w1 + w2;
+				const float centroidInvW{ (1.f / zw0 + 1.f / zw1 + 1.f / zw2) / 3.f };
+				const Vector2 centroidUV{ (uv0 + uv1 + uv2) / (3.f * centroidInvW) };
 
-					w0 /= total;
-					w1 /= total;
-					w2 /= total;
+				const Vector2 dUVdx{ (dUdxy.x - centroidUV.x * dInvWdxy.x) / centroidInvW, (dVdxy.x - centroidUV.y * dInvWdxy.x) / centroidInvW };
+				const Vector2 dUVdy{ (dUdxy.y - centroidUV.x * dInvWdxy.y) / centroidInvW, (dVdxy.y - centroidUV.y * dInvWdxy.y) / centroidInvW };
+				VirtualTexture* pVirtualMap{ material.pVirtualDiffuseMap };
+				const float lod{ pVirtualMap ? pVirtualMap->CalculateLod(dUVdx, dUVdy) : material.pDiffuseMap->CalculateLod(dUVdx, dUVdy) };
 
-					// Check if point is inside the triangle
-					if (w0 >= 0 && w1 >= 0 && w2 >= 0)
+				// Lighting varyings (TBN and view direction) as planes over P - A, no barycentrics needed per pixel
+				auto vectorPlane = [&](const Vector3& f0, const Vector3& f1, const Vector3& f2)
 					{
-						// zBuffer
-						float zBufferValue = 1 / ((w0 / z0) +
-							(w1 / z1) +
-							(w2 / z2));
-
-						// Interpolated Depth -> using correct depth interpolation with w value
-						float interpolatedDepth = 1 / ((w0 / zw0) +
-							(w1 / zw1) +
-							(w2 / zw2));
-
-
-						int pixelIndex = py * m_Width + px;
-
-						// Depth check
-						if (zBufferValue > 0 && zBufferValue < 1) {
-							if (zBufferValue < m_pDepthBufferPixels[pixelIndex])
-							{
-								if (!m_DisplayDepthBuffer) {
-									// Texture
-									Vector2 textureColor{};
-									if (topology == PrimitiveTopology::TriangleStrip && i % 2 != 0) {
-										textureColor = (((vertices_NDC[indices[i]].uv / zw0) * w0) +
-											((vertices_NDC[indices[i + 2]].uv / zw1) * w1) +
-											((vertices_NDC[indices[i + 1]].uv / zw2) * w2)) * interpolatedDepth;
-									}
-									else {
-										textureColor = (((vertices_NDC[indices[i]].uv / zw0) * w0) +
-											((vertices_NDC[indices[i + 1]].uv / zw1) * w1) +
-											((vertices_NDC[indices[i + 2]].uv / zw2) * w2)) * interpolatedDepth;
-									}
+						const Vector2 gradientX{ screenGradient(f0.x / zw0, f1.x / zw1, f2.x / zw2) };
+						const Vector2 gradientY{ screenGradient(f0.y / zw0, f1.y / zw1, f2.y / zw2) };
+						const Vector2 gradientZ{ screenGradient(f0.z / zw0, f1.z / zw1, f2.z / zw2) };
+						return VectorPlane{
+							f0 / zw0,
+							Vector3{ gradientX.x, gradientY.x, gradientZ.x },
+							Vector3{ gradientX.y, gradientY.y, gradientZ.y } };
+					};
+
+				const VectorPlane normalPlane{ vectorPlane(vertex0.normal, vertex1.normal, vertex2.normal) };
+				const VectorPlane tangentPlane{ vectorPlane(vertex0.tangent, vertex1.tangent, vertex2.tangent) };
+				const VectorPlane viewDirectionPlane{ vectorPlane(vertex0.viewDirection, vertex1.viewDirection, vertex2.viewDirection) };
+
+				context.lod = lod;
+				auto shadePacket = [&]()
+					{
+						packet.Pad();
 
-									finalColor += m_pTexture->Sample(textureColor);
-								}
-								else {
-									float depth = Remap(zBufferValue, 0.985f, 1.f, 0.f, 1.f);
-									ColorRGB remappedDepth{ depth, depth, depth };
-									finalColor += remappedDepth;
-								}
+						ShadedPacket shaded;
+						shade(packet, context, shaded);
 
-								// Depth write
-								m_pDepthBufferPixels[pixelIndex] = zBufferValue;
+						if constexpr (State::blendMode == BlendMode::SourceOver)
+						{
+							BlendPacket(packet, shaded, m_PixelPacking, m_pRenderTargetPixels);
+							packet.count = 0;
+							return;
+						}
+						else if constexpr (State::blendMode == BlendMode::WeightedBlended)
+						{
+							AccumulatePacket(packet, shaded, m_pAccumulationPixels, m_pRevealagePixels);
+							packet.count = 0;
+							return;
+						}
 
-								//Update Color in Buffer
-								finalColor.MaxToOne();
+						WritePacket(packet, shaded, m_PixelPacking, m_pRenderTargetPixels);
+						packet.count = 0;
+					};
 
-								m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-									static_cast<uint8_t>(finalColor.r * 255),
-									static_cast<uint8_t>(finalColor.g * 255),
-									static_cast<uint8_t>(finalColor.b * 255));
+				for (int px{ minX }; px < maxX; ++px)
+				{
+					for (int py{ minY }; py < maxY; ++py)
+					{
+						Vector2 P{ px + 0.5f, py + 0.5f };
+
+						// Direction from NDC to P(ixel Point)
+						Vector2 AP = P - A;
+						Vector2 BP = P - B;
+						Vector2 CP = P - C;
+
+						// Barycentric weights
+						float w0 = (Vector2::Cross(edge1, BP));
+						float w1 = (Vector2::Cross(edge2, CP));
+						float w2 = (Vector2::Cross(edge0, AP));
+
+						// Total Triangle Area 
+						float total = w0 + w1 + w2;
+
+						w0 /= total;
+						w1 /= total;
+						w2 /= total;
+
+						// Check if point is inside the triangle
+						if (w0 >= 0 && w1 >= 0 && w2 >= 0)
+						{
+							// zBuffer
+							float zBufferValue = 1 / ((w0 / z0) +
+								(w1 / z1) +
+								(w2 / z2));
+
+							// Interpolated Depth -> using correct depth interpolation with w value
+							float interpolatedDepth = 1 / ((w0 / zw0) +
+								(w1 / zw1) +
+								(w2 / zw2));
+
+
+							int pixelIndex = py * m_Width + px;
+
+							// Depth check
+							if (zBufferValue > 0 && zBufferValue < 1) {
+								if (zBufferValue < m_pDepthBufferPixels[pixelIndex])
+								{
+									// Depth write, a triangle never covers a pixel twice so the packet can wait
+									if constexpr (!State::isTransparent)
+										m_pDepthBufferPixels[pixelIndex] = zBufferValue;
+
+									if constexpr (!State::displayDepth) {
+										// Texture
+										const Vector2 textureColor{ ((uv0 * w0) + (uv1 * w1) + (uv2 * w2)) * interpolatedDepth };
+
+										const Vector3 normal{ normalPlane.At(AP) * interpolatedDepth };
+										const Vector3 tangent{ tangentPlane.At(AP) * interpolatedDepth };
+										const Vector3 viewDirection{ viewDirectionPlane.At(AP) * interpolatedDepth };
+
+										packet.Add(pixelIndex, interpolatedDepth, textureColor, normal, tangent, viewDirection);
+										if (packet.count == FragmentPacket::capacity)
+											shadePacket();
+									}
+									else {
+										float depth = Remap(zBufferValue, 0.985f, 1.f, 0.f, 1.f);
+										const uint8_t gray{ static_cast<uint8_t>(Saturate(depth) * 255) };
+
+										//Update Color in Buffer
+										m_pRenderTargetPixels[pixelIndex] = m_PixelPacking.Pack(gray, gray, gray);
+									}
+								}
 							}
 						}
 					}
 				}
+
+				// The lod is per triangle, so the packet never crosses one
+				if (packet.count > 0)
+					shadePacket();
+			}
+		}
+	}
+
+	void Renderer::ResolveTransparency() const
+	{
+		// Tiles are independent, so the resolve scales with the pixel count and the workers
+		std::vector<std::future<void>> tiles{};
+		for (int minY{ 0 }; minY < m_ViewportHeight; minY += m_ResolveTileSize)
+		{
+			for (int minX{ 0 }; minX < m_ViewportWidth; minX += m_ResolveTileSize)
+			{
+				const int maxX{ std::min(minX + m_ResolveTileSize, m_ViewportWidth) };
+				const int maxY{ std::min(minY + m_ResolveTileSize, m_ViewportHeight) };
+				tiles.push_back(m_TilePool.Submit([this, minX, minY, maxX, maxY]() { ResolveTile(minX, minY, maxX, maxY); }));
+			}
+		}
+
+		for (std::future<void>& tile : tiles)
+		{
+			tile.wait();
+		}
+	}
+
+	void Renderer::ResolveTile(int minX, int minY, int maxX, int maxY) const
+	{
+		const PixelPacking& packing{ m_PixelPacking };
+		const __m128 toFloat{ _mm_set1_ps(1.f / 255.f) };
+		const __m128 zero{ _mm_setzero_ps() };
+
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				const int pixelIndex{ py * m_Width + px };
+				const float revealage{ m_pRevealagePixels[pixelIndex] };
+				if (revealage >= 1.f)
+					continue;
+
+				// Weighted average of the layers, over the opaque color by (1 - revealage)
+				float* pRecord{ m_pAccumulationPixels + 4 * static_cast<size_t>(pixelIndex) };
+				const __m128 accumulation{ _mm_load_ps(pRecord) };
+				const __m128 totalWeight{ _mm_max_ps(_mm_shuffle_ps(accumulation, accumulation, _MM_SHUFFLE(3, 3, 3, 3)), _mm_set1_ps(1e-5f)) };
+				const __m128 average{ _mm_div_ps(accumulation, totalWeight) };
+
+				const uint32_t pixel{ m_pRenderTargetPixels[pixelIndex] };
+				const __m128 destination{ _mm_mul_ps(_mm_setr_ps(
+					static_cast<float>((pixel >> packing.redShift) & 0xFF),
+					static_cast<float>((pixel >> packing.greenShift) & 0xFF),
+					static_cast<float>((pixel >> packing.blueShift) & 0xFF),
+					0.f), toFloat) };
+
+				const __m128 reveal{ _mm_set1_ps(revealage) };
+				const __m128 color{ _mm_add_ps(_mm_mul_ps(average, _mm_sub_ps(_mm_set1_ps(1.f), reveal)), _mm_mul_ps(destination, reveal)) };
+
+				// Lanes hold r, g, b, so the packed result is in the first lane
+				const __m128 r{ _mm_shuffle_ps(color, color, _MM_SHUFFLE(0, 0, 0, 0)) };
+				const __m128 g{ _mm_shuffle_ps(color, color, _MM_SHUFFLE(1, 1, 1, 1)) };
+				const __m128 b{ _mm_shuffle_ps(color, color, _MM_SHUFFLE(2, 2, 2, 2)) };
+				m_pRenderTargetPixels[pixelIndex] = static_cast<uint32_t>(_mm_cvtsi128_si32(PackColors4(r, g, b, packing)));
+
+				// Ready for the next frame
+				_mm_store_ps(pRecord, zero);
+				m_pRevealagePixels[pixelIndex] = 1.f;
 			}
 		}
 	}
@@ -664,8 +1710,27 @@ namespace dae {
 		m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView, &color.r);
 		m_pDeviceContext->ClearDepthStencilView(m_pDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
 
-		// 2. SET pipeline + invoke draw call (= render)
-		m_pMesh->Render(m_pDeviceContext);
+		// 2. SET pipeline + invoke draw call (= render), the draw list is sorted so state repeats
+		const Mesh* pPreviousMesh{ nullptr };
+		const Texture* pPreviousTexture{ nullptr };
+		for (const DrawItem& item : m_Scene.GetDrawList())
+		{
+			const SceneEntry& entry{ m_Scene.GetEntry(item.entryId) };
+			Mesh* pMesh{ m_Scene.GetMesh(entry.meshId) };
+
+			pMesh->SetMatrix(item.world * m_ViewProjection);
+			pMesh->SetWorldMatrix(item.world);
+			pMesh->SetViewProjectionMatrix(m_ViewProjection);
+
+			if (pMesh != pPreviousMesh || entry.material.pDiffuseMap != pPreviousTexture)
+			{
+				pMesh->SetDiffuseMap(entry.material.pDiffuseMap);
+			}
+			pPreviousMesh = pMesh;
+			pPreviousTexture = entry.material.pDiffuseMap;
+
+			pMesh->Render(m_pDeviceContext, entry.material.isTransparent);
+		}
 
 		// 3. Present backbuffer (swap)
 		m_pSwapChain->Present(0, 0);
@@ -680,20 +1745,22 @@ namespace dae {
 		std::cout << "   [F9]  Cycle CullMode (BACK/FRONT/NONE)\n"; // TODO
 		std::cout << "   [F10]  Toggle Uniform ClearColor (ON/OFF)\n";
 		std::cout << "   [F11]  Toggle Print FPS (ON/OFF)\n";
-		std::cout << "\033[0m" << std::endl;
-
-		std::cout << "\033[32m"; // Set color to Green
-		std::cout << "[Key Bindings - HARDWARE] \n";
-		std::cout << "   [F3]  Toggle FireFX (ON/OFF)\n"; // TODO
-		std::cout << "   [F4]  Cycle Sampler State (ON/OFF)\n";
+		std::cout << "   [I]  Toggle Fleet Instancing (ON/OFF)\n";
+		std::cout << "   [F4]  Cycle Sampler State (POINT/LINEAR/ANISOTROPIC)\n";
+		std::cout << "   [F3]  Toggle FireFX (ON/OFF)\n";
 		std::cout << "\033[0m" << std::endl;
 
 		std::cout << "\033[35m"; // Set color to Purple
 		std::cout << "[Key Bindings - SHARED] \n";
-		std::cout << "   [F5]  Cycle Shading Mode (COMBINED/OBSERVED_AREA/DIFFUSE/SPECULAR)\n"; // TODO
-		std::cout << "   [F6]  Toggle NormalMap (ON/OFF)\n"; // TODO
+		std::cout << "   [F5]  Cycle Shading Mode (COMBINED/OBSERVED_AREA/DIFFUSE/SPECULAR)\n";
+		std::cout << "   [F6]  Toggle NormalMap (ON/OFF)\n";
 		std::cout << "   [F7]  Toggle DepthBuffer Visualization (ON/OFF)\n";
 		std::cout << "   [F8]  Toggle BoundingBox Visualization (ON/OFF)\n";
+		std::cout << "   [O]  Toggle Order Independent Transparency (ON/OFF)\n";
+		std::cout << "   [P]  Cycle Present Latency (0/1/2 FRAMES)\n";
+		std::cout << "   [R]  Toggle Dynamic Resolution (ON/OFF)\n";
+		std::cout << "   [C]  Toggle Frame Capture (capture_NNNNN.png)\n";
+		std::cout << "   [V]  Toggle Virtual Texturing (ON/OFF)\n";
 		std::cout << "\033[0m" << std::endl;
 	}
 }
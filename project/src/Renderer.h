@@ -3,16 +3,59 @@
 #include "Camera.h"
 #include "Matrix.h"
 #include "Texture.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "TextureManager.h"
+#include "PixelShader.h"
+#include "FramePresenter.h"
+#include "ResolutionGovernor.h"
+#include "FrameCapture.h"
 
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
+	// Channel layout of the software render target, resolved once per frame instead of per pixel
+	struct PixelPacking
+	{
+		int redShift{ 16 };
+		int greenShift{ 8 };
+		int blueShift{ 0 };
+		// Written into every pixel, like SDL_MapRGB does for formats with alpha
+		uint32_t alphaMask{};
+
+		uint32_t Pack(uint8_t r, uint8_t g, uint8_t b) const
+		{
+			return (static_cast<uint32_t>(r) << redShift) | (static_cast<uint32_t>(g) << greenShift) | (static_cast<uint32_t>(b) << blueShift) | alphaMask;
+		}
+	};
+
+	enum class BlendMode
+	{
+		Opaque,
+		SourceOver,			// transparent, blended in draw order
+		WeightedBlended		// transparent, accumulated in any order and resolved once per frame
+	};
+
+	// Software raster state resolved once per draw, every combination is its own branch free raster kernel.
+	// Shading state is resolved by the pixel shader (see PixelShaderRegistry)
+	template<PrimitiveTopology topologyValue, bool displayDepthValue, BlendMode blendModeValue>
+	struct RasterState
+	{
+		static constexpr PrimitiveTopology topology{ topologyValue };
+		static constexpr bool displayDepth{ displayDepthValue };
+		static constexpr BlendMode blendMode{ blendModeValue };
+		// Transparent modes are depth tested without depth write
+		static constexpr bool isTransparent{ blendModeValue != BlendMode::Opaque };
+	};
+
 	class Renderer final
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
+		// Headless: software rasterizer into an in-memory frame of any size, no window and no D3D device
+		Renderer(int width, int height);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -21,16 +64,35 @@ namespace dae
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
 		void Update(const Timer* pTimer);
+		// Without camera input, for a fixed time step
+		void Update(float elapsedSec);
 		void Render() const;
 
+		// Headless helpers: blocks until every texture is in the scene, drives the camera, and the last software frame
+		void WaitForPendingTextures();
+		void SetCameraPose(const Vector3& origin, float yaw, float pitch);
+		SDL_Surface* GetFrame() const { return m_pBackBuffer; }
+		bool IsInitialized() const { return m_IsInitialized; }
+
+		// Software frames to disk on a writer thread, format from the extension (see FrameCapture)
+		bool StartCapture(const std::string& path, float frameRate);
+		void StopCapture();
+
+		// Forces the next frame to be drawn, for when the window lost its contents
+		void Invalidate();
+		// True when the last Update found nothing to draw, the caller can wait for events instead of spinning
+		bool IsIdle() const { return m_IsIdle && (!m_pPresenter || m_pPresenter->IsIdle()); }
+
 		// Toggle Both
 		void ToggleRasterizerMode();
 		void ToggleVehicleRotation();
 		void CycleCullMode();
 		void ToggleUniformClearColor();
+		void ToggleFleetInstancing();
 
-		// Toggle Hardware
 		void ToggleFireFX();
+
+		// Toggle Hardware
 		void ToggleTechnique();
 
 		// Toggle Software
@@ -38,6 +100,11 @@ namespace dae
 		void ToggleNormalMap();
 		void ToggleDepthBufferVisualisation();
 		void ToggleBoundingBoxVisualisation();
+		void ToggleOrderIndependentTransparency();
+		void CyclePresentLatency();
+		void ToggleDynamicResolution();
+		void ToggleFrameCapture();
+		void ToggleVirtualTexturing();
 
 	private:
 		// Window Variables
@@ -50,10 +117,39 @@ namespace dae
 	
 		// Software Variables
 		SDL_Surface* m_pFrontBuffer{ nullptr };
+		// Same surface as the front buffer when the window format allows it (no blit at present)
 		SDL_Surface* m_pBackBuffer{ nullptr };
-		uint32_t* m_pBackBufferPixels{};
+		bool m_RenderToWindow{ false };
+
+		// Frames queued for the presenter thread, 0 presents on the render thread (P).
+		// 0 by default when rendering into the window, 1 or more always adds a full frame copy
+		FramePresenter* m_pPresenter{};
+		int m_PresentLatency{ 1 };
+
+		// Dynamic resolution: the software path rasterizes a viewport of up to m_Width x m_Height (R)
+		SDL_Surface* m_pScaledBuffer{};
+		ResolutionGovernor m_ResolutionGovernor{};
+		bool m_DynamicResolution{ false };
+		int m_ViewportWidth{};
+		int m_ViewportHeight{};
+
+		// Every finished software frame is handed to it while capturing (C)
+		FrameCapture* m_pCapture{};
+
+		// Surface the current frame is rasterized into, picked at the start of every software frame
+		mutable SDL_Surface* m_pRenderTarget{};
+		mutable uint32_t* m_pRenderTargetPixels{};
+		mutable PixelPacking m_PixelPacking{};
 		float* m_pDepthBufferPixels{};
 
+		// Weighted blended transparency: premultiplied color * weight and alpha * weight (4 floats per pixel),
+		// revealage is the product of (1 - alpha). Both are cleared again by the resolve
+		float* m_pAccumulationPixels{};
+		float* m_pRevealagePixels{};
+		// Per frame tile jobs, submitted from the const render path
+		mutable ThreadPool m_TilePool{};
+		const int m_ResolveTileSize{ 64 };
+
 		// Hardware variables
 		HRESULT InitializeDirectX();
 
@@ -68,25 +164,59 @@ namespace dae
 		ID3D11RenderTargetView* m_pRenderTargetView{};
 
 		// Standard Variables
-		Mesh* m_pMesh{};
+		Scene m_Scene{};
 		Camera m_Camera{};
 
-		std::vector<Vertex_PosCol> m_Vertices{};
-		std::vector<uint32_t> m_Indices{};
+		uint32_t m_VehicleMeshId{};
+		uint32_t m_VehicleEntryId{};
+		uint32_t m_FireFXEntryId{};
+
+		// Paged vehicle diffuse map, opened the first time it is switched on (V)
+		VirtualTexture* m_pVehicleVirtualDiffuse{};
+		bool m_VirtualTexturing{ false };
+
+		// Textures decoding on the loader pool, their entry shows the placeholder until then
+		struct PendingTexture
+		{
+			std::shared_future<TextureHandle> texture;
+			uint32_t entryId;
+			Texture* Material::* map;
+		};
+		ThreadPool m_LoaderPool{};
+		TextureManager* m_pTextureManager{};
+		std::vector<PendingTexture> m_PendingTextures{};
 
 		float m_Rotationspeed{ 0.9f };
 		float m_Rotation{};
 
 		Matrix m_World{};
-		Matrix wvpMatrix{};
+		Matrix m_ViewProjection{};
+
+		// Change tracking: what the frame on screen was drawn with. Toggles mark the frame dirty themselves
+		Matrix m_DrawnWorld{};
+		uint64_t m_DrawnSceneRevision{};
+		mutable bool m_IsFrameDirty{ true };
+		bool m_IsIdle{ false };
 
-		Texture* m_pTexture{};
 		float m_AspectRatio;
+		int m_TechniqueIdx{ 0 };
+
+		void Initialize();
+		uint32_t LoadMesh(const std::string& path);
+		void UpdatePendingTextures();
+		void UpdateDynamicResolution(float frameTime, bool isFrameTimeValid);
+		void UpdateTextureResidency(Texture* pTexture) const;
+		Material GetSoftwareMaterial(const Material& material) const;
+		VirtualTexture* LoadVirtualTexture(const std::string& imagePath);
 		
 		// render modes
 		void RenderSoftware() const;
-		void VertexTransformationFunction(Mesh* mesh) const;
-		void RenderSoftwareMesh(Mesh* mesh) const;
+		void VertexTransformationFunction(Mesh* mesh, const Matrix& world) const;
+		void RenderSoftwareMesh(Mesh* mesh, const Material& material) const;
+		template<typename State>
+		void RasterizeMesh(Mesh* mesh, const Material& material) const;
+		void ResolveTransparency() const;
+		void ResolveTile(int minX, int minY, int maxX, int maxY) const;
 		float Remap(float value, float low1, float high1, float low2, float high2) const;
 		void RenderHardware() const;
 
@@ -100,7 +230,17 @@ namespace dae
 
 		bool m_FireFX{ false };
 
+		// Fleet instancing
+		bool m_FleetEnabled{ false };
+		const int m_FleetColumns{ 16 };
+		const int m_FleetRows{ 16 };
+		const Vector2 m_FleetSpacing{ 45.f, 20.f };
+
+		PixelShaderRegistry m_PixelShaders{};
+		ShadingMode m_ShadingMode{ ShadingMode::Combined };
+		bool m_NormalMapEnabled{ true };
 		bool m_DisplayDepthBuffer{ false };
 		bool m_DisplayBoundingBox{ false };
+		bool m_OrderIndependentTransparency{ false };
 	};
 }
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "ResolutionGovernor.h"
+
+namespace dae
+{
+	ResolutionGovernor::ResolutionGovernor(float targetFrameTime) :
+		m_TargetFrameTime{ targetFrameTime },
+		m_AverageFrameTime{ targetFrameTime }
+	{
+	}
+
+	float ResolutionGovernor::Update(float frameTime)
+	{
+		// Hitches (loading, window drags) would otherwise drag the average down to the minimum
+		frameTime = std::min(frameTime, 4.f * m_TargetFrameTime);
+		m_AverageFrameTime += (frameTime - m_AverageFrameTime) * m_Smoothing;
+
+		if (m_CooldownFrames > 0)
+		{
+			--m_CooldownFrames;
+			return m_Scale;
+		}
+
+		// Pixel cost goes with the area, so the scale follows the square root of the ratio
+		const float ratio{ m_TargetFrameTime / m_AverageFrameTime };
+		if (m_AverageFrameTime > m_TargetFrameTime * m_DownThreshold && m_Scale > minScale)
+		{
+			m_Scale = std::max(minScale, m_Scale * std::max(std::sqrt(ratio), 0.85f));
+			m_FastFrames = 0;
+			m_CooldownFrames = m_Cooldown;
+		}
+		else if (m_AverageFrameTime < m_TargetFrameTime * m_UpThreshold && m_Scale < maxScale)
+		{
+			if (++m_FastFrames >= m_UpDelay)
+			{
+				m_Scale = std::min(maxScale, m_Scale + 0.05f);
+				m_FastFrames = 0;
+				m_CooldownFrames = m_Cooldown;
+			}
+		}
+		else
+		{
+			m_FastFrames = 0;
+		}
+		return m_Scale;
+	}
+
+	void ResolutionGovernor::Reset()
+	{
+		m_AverageFrameTime = m_TargetFrameTime;
+		m_Scale = maxScale;
+		m_FastFrames = 0;
+		m_CooldownFrames = 0;
+	}
+}
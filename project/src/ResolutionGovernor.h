@@ -0,0 +1,36 @@
+#pragma once
+
+namespace dae
+{
+	// Picks the software render scale that holds a target frame time: drops resolution quickly when frames
+	// run long and only raises it again after a stretch of fast frames, so it does not oscillate
+	class ResolutionGovernor final
+	{
+	public:
+		static constexpr float minScale{ 0.5f };
+		static constexpr float maxScale{ 1.f };
+
+		explicit ResolutionGovernor(float targetFrameTime = 1.f / 60.f);
+
+		// Once per frame with the time the last frame took, returns the scale for the next one
+		float Update(float frameTime);
+		void Reset();
+
+		void SetTargetFrameTime(float seconds) { m_TargetFrameTime = seconds; }
+		float GetTargetFrameTime() const { return m_TargetFrameTime; }
+		float GetScale() const { return m_Scale; }
+
+	private:
+		static constexpr float m_Smoothing{ 0.1f };			// weight of the newest frame in the average
+		static constexpr float m_DownThreshold{ 1.05f };	// of the target
+		static constexpr float m_UpThreshold{ 0.8f };
+		static constexpr int m_UpDelay{ 30 };				// fast frames before the scale goes up
+		static constexpr int m_Cooldown{ 10 };				// frames to settle after every change
+
+		float m_TargetFrameTime{};
+		float m_AverageFrameTime{};
+		float m_Scale{ maxScale };
+		int m_FastFrames{};
+		int m_CooldownFrames{};
+	};
+}
@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "Scene.h"
+
+namespace dae
+{
+	namespace
+	{
+		// Key layout (high to low bits)
+		// opaque:      [63] 0 | [62..55] effect | [54..39] texture | [38..15] depth (near first)
+		// transparent: [63] 1 | [62..39] depth (far first) | [38..31] effect | [30..15] texture
+		constexpr uint64_t depthBits{ 24 };
+		constexpr uint64_t depthMask{ (uint64_t(1) << depthBits) - 1 };
+		constexpr uint64_t effectMask{ 0xFF };
+		constexpr uint64_t textureMask{ 0xFFFF };
+
+		constexpr float maxSortDepth{ 1000.f };
+
+		uint64_t QuantizeDepth(float viewDepth)
+		{
+			const float normalized{ Saturate(viewDepth / maxSortDepth) };
+			return static_cast<uint64_t>(normalized * static_cast<float>(depthMask)) & depthMask;
+		}
+	}
+
+	Scene::~Scene()
+	{
+		for (Mesh* pMesh : m_Meshes)
+		{
+			delete pMesh;
+		}
+		m_Meshes.clear();
+
+		for (VirtualTexture* pTexture : m_VirtualTextures)
+		{
+			delete pTexture;
+		}
+		m_VirtualTextures.clear();
+	}
+
+	uint32_t Scene::AddMesh(Mesh* pMesh)
+	{
+		m_Meshes.push_back(pMesh);
+		++m_Revision;
+		return static_cast<uint32_t>(m_Meshes.size() - 1);
+	}
+
+	uint32_t Scene::AddTexture(const TextureHandle& pTexture)
+	{
+		const auto it{ m_TextureIds.find(pTexture.get()) };
+		if (it != m_TextureIds.end())
+			return it->second;
+
+		m_Textures.push_back(pTexture);
+		++m_Revision;
+		const uint32_t textureId{ static_cast<uint32_t>(m_Textures.size() - 1) };
+		m_TextureIds.emplace(pTexture.get(), textureId);
+		return textureId;
+	}
+
+	void Scene::AddVirtualTexture(VirtualTexture* pTexture)
+	{
+		m_VirtualTextures.push_back(pTexture);
+		++m_Revision;
+	}
+
+	uint32_t Scene::AddEntry(uint32_t meshId, const Material& material, const Matrix& transform)
+	{
+		SceneEntry entry{};
+		entry.meshId = meshId;
+		entry.material = material;
+		entry.transform = transform;
+		m_Entries.push_back(entry);
+		++m_Revision;
+		return static_cast<uint32_t>(m_Entries.size() - 1);
+	}
+
+	void Scene::SetEntryVisible(uint32_t entryId, bool isVisible)
+	{
+		m_Entries[entryId].isVisible = isVisible;
+		++m_Revision;
+	}
+
+	void Scene::SetMaterial(uint32_t entryId, const Material& material)
+	{
+		m_Entries[entryId].material = material;
+		++m_Revision;
+	}
+
+	void Scene::BuildDrawList(const Matrix& root, const Matrix& viewMatrix)
+	{
+		m_DrawList.clear();
+		m_DrawList.reserve(m_Entries.size());
+
+		for (uint32_t entryId = 0; entryId < m_Entries.size(); ++entryId)
+		{
+			const SceneEntry& entry{ m_Entries[entryId] };
+			if (!entry.isVisible)
+				continue;
+
+			DrawItem item{};
+			item.entryId = entryId;
+			item.world = root * entry.transform;
+
+			const float viewDepth{ viewMatrix.TransformPoint(item.world.GetTranslation()).z };
+			const uint64_t depth{ QuantizeDepth(viewDepth) };
+			const uint64_t effect{ entry.meshId & effectMask };
+			const uint64_t texture{ GetTextureId(entry.material.pDiffuseMap) & textureMask };
+
+			if (entry.material.isTransparent)
+			{
+				item.key = (uint64_t(1) << 63) | ((depthMask - depth) << 39) | (effect << 31) | (texture << 15);
+			}
+			else
+			{
+				item.key = (effect << 55) | (texture << 39) | (depth << 15);
+			}
+
+			m_DrawList.push_back(item);
+		}
+
+		std::sort(m_DrawList.begin(), m_DrawList.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+	}
+
+	uint32_t Scene::GetTextureId(const Texture* pTexture) const
+	{
+		const auto it{ m_TextureIds.find(pTexture) };
+		return it != m_TextureIds.end() ? it->second : 0;
+	}
+}
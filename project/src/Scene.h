@@ -0,0 +1,84 @@
+#pragma once
+#include "Mesh.h"
+#include "Texture.h"
+#include "VirtualTexture.h"
+#include <unordered_map>
+
+namespace dae
+{
+	struct Material
+	{
+		Texture* pDiffuseMap{};
+		// Software only, takes over from pDiffuseMap when set
+		VirtualTexture* pVirtualDiffuseMap{};
+		// Lighting maps of the software shading stage, optional
+		Texture* pNormalMap{};
+		Texture* pSpecularMap{};
+		Texture* pGlossMap{};
+		// Software pixel shader, id from the renderer's PixelShaderRegistry (0 = Phong)
+		uint32_t pixelShaderId{};
+		bool isTransparent{ false };
+	};
+
+	struct SceneEntry
+	{
+		uint32_t meshId{};
+		Material material{};
+		Matrix transform{};
+		bool isVisible{ true };
+	};
+
+	// One entry of the per-frame draw list, sorted on key
+	struct DrawItem
+	{
+		uint64_t key{};
+		uint32_t entryId{};
+		Matrix world{};
+	};
+
+	class Scene final
+	{
+	public:
+		Scene() = default;
+		~Scene();
+
+		Scene(const Scene&) = delete;
+		Scene(Scene&&) noexcept = delete;
+		Scene& operator=(const Scene&) = delete;
+		Scene& operator=(Scene&&) noexcept = delete;
+
+		// The scene takes ownership of meshes and keeps its textures alive
+		uint32_t AddMesh(Mesh* pMesh);
+		uint32_t AddTexture(const TextureHandle& pTexture);
+		void AddVirtualTexture(VirtualTexture* pTexture);
+		uint32_t AddEntry(uint32_t meshId, const Material& material, const Matrix& transform = {});
+
+		void SetEntryVisible(uint32_t entryId, bool isVisible);
+		// Textures of the material have to be added to the scene first
+		void SetMaterial(uint32_t entryId, const Material& material);
+
+		// Opaque front-to-back grouped by effect and texture, transparent back-to-front
+		void BuildDrawList(const Matrix& root, const Matrix& viewMatrix);
+
+		const std::vector<DrawItem>& GetDrawList() const { return m_DrawList; }
+		const SceneEntry& GetEntry(uint32_t entryId) const { return m_Entries[entryId]; }
+		Mesh* GetMesh(uint32_t meshId) const { return m_Meshes[meshId]; }
+		const std::vector<Mesh*>& GetMeshes() const { return m_Meshes; }
+		const std::vector<TextureHandle>& GetTextures() const { return m_Textures; }
+		const std::vector<VirtualTexture*>& GetVirtualTextures() const { return m_VirtualTextures; }
+		// Bumped by every change to meshes, textures or entries
+		uint64_t GetRevision() const { return m_Revision; }
+
+	private:
+		std::vector<Mesh*> m_Meshes{};
+		std::vector<TextureHandle> m_Textures{};
+		std::unordered_map<const Texture*, uint32_t> m_TextureIds{};
+		std::vector<VirtualTexture*> m_VirtualTextures{};
+
+		std::vector<SceneEntry> m_Entries{};
+		std::vector<DrawItem> m_DrawList{};
+		uint64_t m_Revision{};
+
+		uint32_t GetTextureId(const Texture* pTexture) const;
+	};
+}
@@ -1,16 +1,114 @@
 #include "Texture.h"
+#include "BlockCompression.h"
 #include <SDL_image.h>
+#include <atomic>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
 
 namespace dae {
-	Texture::Texture(SDL_Surface* pSurface, ID3D11Device* pDevice) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+	namespace
 	{
-		Load(pSurface, pDevice);
+		constexpr float toFloat{ 1.0f / 255.0f };
+
+		inline int FloorToInt(float value)
+		{
+			const int truncated = static_cast<int>(value);
+			return truncated - (value < static_cast<float>(truncated) ? 1 : 0);
+		}
+
+		inline ColorRGB ToColor(uint32_t texel)
+		{
+			return ColorRGB{
+				static_cast<float>(texel & 0xFF) * toFloat,
+				static_cast<float>((texel >> 8) & 0xFF) * toFloat,
+				static_cast<float>((texel >> 16) & 0xFF) * toFloat };
+		}
+
+		inline bool IsPowerOfTwo(int value)
+		{
+			return value > 0 && (value & (value - 1)) == 0;
+		}
+
+		inline int GetBlockBytes(TexelFormat format)
+		{
+			return format == TexelFormat::BC1 ? BlockCompression::bc1BlockBytes : BlockCompression::bc3BlockBytes;
+		}
+
+		const char* GetCacheExtension(TexelFormat format)
+		{
+			switch (format)
+			{
+			case TexelFormat::BC1: return ".bc1";
+			case TexelFormat::BC3: return ".bc3";
+			case TexelFormat::BC5: return ".bc5";
+			default: return "";
+			}
+		}
+
+		// Cache file: header, then per level its size and blocks
+		struct CacheHeader
+		{
+			uint32_t magic{};
+			uint32_t version{};
+			uint32_t format{};
+			uint32_t levelCount{};
+		};
+		constexpr uint32_t cacheMagic{ 0x58544342 }; // "BCTX"
+		constexpr uint32_t cacheVersion{ 1 };
+		// D3D11 texture size limit and the length of its mip chain
+		constexpr int32_t maxCacheSize{ 16384 };
+		constexpr uint32_t maxCacheLevels{ 15 };
+
+		// Recently decoded blocks, direct mapped on the block address
+		struct DecodedBlock
+		{
+			const uint8_t* pBlock{};
+			uint32_t textureId{};
+			uint32_t texels[16]{};
+		};
+		constexpr size_t decodedBlockCount{ 64 };
+		thread_local DecodedBlock decodedBlocks[decodedBlockCount]{};
+
+		std::atomic<uint32_t> nextTextureId{ 1 };
+	}
+
+	Texture::Texture(const std::string& path, ID3D11Device* pDevice, TexelLayout layout, TexelFormat format) :
+		m_Id{ nextTextureId++ },
+		m_Path{ path }
+	{
+		const std::string cachePath = path + GetCacheExtension(format);
+		if (format == TexelFormat::RGBA8 || !ReadCache(cachePath, format))
+		{
+			Convert(IMG_Load(path.c_str()));
+			BuildMipChain();
+
+			if (format != TexelFormat::RGBA8 && Compress(format)) {
+				WriteCache(cachePath);
+			}
+		}
+		Load(pDevice);
+
+		// D3D gets the linear levels, the CPU copy is reordered afterwards
+		m_Layout = layout;
+		Swizzle(layout);
+	}
+
+	Texture::Texture(uint32_t texel, ID3D11Device* pDevice) :
+		m_Id{ nextTextureId++ }
+	{
+		MipLevel level = CreateMipLevel(1, 1);
+		level.texels.front() = texel;
+		m_MipLevels.push_back(std::move(level));
+
+		Load(pDevice);
 	}
 
 	Texture::~Texture()
 	{
+		m_MipLevels.clear();
+
 		if (m_pResource)
 		{
 			m_pResource->Release();
@@ -23,42 +121,750 @@ namespace dae {
 		}
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path, ID3D11Device* pDevice)
+	Texture* Texture::LoadFromFile(const std::string& path, ID3D11Device* pDevice, TexelLayout layout, TexelFormat format)
 	{
-		return new Texture{ IMG_Load(path.c_str()), pDevice };
+		return new Texture{ path, pDevice, layout, format };
+	}
+
+	Texture* Texture::CreatePlaceholder(ID3D11Device* pDevice, uint32_t texel)
+	{
+		return new Texture{ texel, pDevice };
 	}
 
 	ColorRGB Texture::Sample(const Vector2& uv) const
 	{
-		if (!m_pSurface || !m_pSurfacePixels) {
+		if (m_MipLevels.empty() || !m_IsCpuResident) {
+			return ColorRGB{ 0.0f, 0.0f, 0.0f }; // Return black if surface is not initialized
+		}
+
+		// Nearest texel of the full resolution level, wrap addressing like the hardware samplers
+		const MipLevel& level = m_MipLevels.front();
+		return ToColor(Fetch(level, FloorToInt(uv.x * level.width), FloorToInt(uv.y * level.height)));
+	}
+
+	ColorRGB Texture::Sample(const Vector2& uv, float lod) const
+	{
+		if (m_MipLevels.empty() || !m_IsCpuResident) {
 			return ColorRGB{ 0.0f, 0.0f, 0.0f }; // Return black if surface is not initialized
 		}
-		
-		// Clamp UV coordinates to [0, 1]
-		float u = Clamp(uv.x, 0.0f, 1.0f);
-		float v = Clamp(uv.y, 0.0f, 1.0f);
-		
-		// Convert uv to pixel coordinates
-		int px = static_cast<int>(u * m_pSurface->w);
-		int py = static_cast<int>(v * m_pSurface->h);
-		
-		// Compute the 1D pixel index
-		uint32_t pixel = m_pSurfacePixels[px + (m_pSurface->w * py)];
-		
-		// Extract RGB components
-		Uint8 r, g, b;
-		SDL_GetRGB(pixel, m_pSurface->format, &r, &g, &b);
-		
-		return ColorRGB{ r / 255.0f, g / 255.0f, b / 255.0f };
-	}
-
-	void Texture::Load(const SDL_Surface* pSurface, ID3D11Device* pDevice)
+
+		// Magnification and the smallest level don't need a second level
+		const float maxLod = static_cast<float>(m_MipLevels.size() - 1);
+		lod = Clamp(lod, 0.0f, maxLod);
+
+		const int level = static_cast<int>(lod);
+		const float levelBlend = lod - static_cast<float>(level);
+
+		const ColorRGB fine = SampleBilinear(m_MipLevels[level], uv.x, uv.y);
+		if (levelBlend <= 0.0f || level + 1 >= static_cast<int>(m_MipLevels.size())) {
+			return fine;
+		}
+
+		const ColorRGB coarse = SampleBilinear(m_MipLevels[level + 1], uv.x, uv.y);
+		return ColorRGB::Lerp(fine, coarse, levelBlend);
+	}
+
+	void Texture::Sample4(__m128 u, __m128 v, float lod, SamplerFilter filter, __m128& r, __m128& g, __m128& b) const
+	{
+		__m128 a;
+		SampleChannels4<false>(u, v, lod, filter, r, g, b, a);
+	}
+
+	void Texture::Sample4(__m128 u, __m128 v, float lod, SamplerFilter filter, __m128& r, __m128& g, __m128& b, __m128& a) const
+	{
+		SampleChannels4<true>(u, v, lod, filter, r, g, b, a);
+	}
+
+	template<bool hasAlpha>
+	void Texture::SampleChannels4(__m128 u, __m128 v, float lod, SamplerFilter filter, __m128& r, __m128& g, __m128& b, __m128& a) const
+	{
+		if (m_MipLevels.empty() || !m_IsCpuResident) {
+			r = g = b = a = _mm_setzero_ps();
+			return;
+		}
+
+		const float maxLod = static_cast<float>(m_MipLevels.size() - 1);
+		lod = Clamp(lod, 0.0f, maxLod);
+
+		alignas(16) uint32_t texels[4];
+		if (filter == SamplerFilter::Point)
+		{
+			FetchPoint4(m_MipLevels[static_cast<int>(lod + 0.5f)], u, v, texels);
+		}
+		else
+		{
+			const int level = static_cast<int>(lod);
+			FilterBilinear4<hasAlpha>(m_MipLevels[level], u, v, texels);
+
+			// Blend towards the next level in 8.8 fixed point
+			const int levelBlend = static_cast<int>((lod - static_cast<float>(level)) * 256.0f);
+			if (levelBlend > 0 && level + 1 < static_cast<int>(m_MipLevels.size()))
+			{
+				alignas(16) uint32_t coarseTexels[4];
+				FilterBilinear4<hasAlpha>(m_MipLevels[level + 1], u, v, coarseTexels);
+
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i fineWeight = _mm_set1_epi16(static_cast<short>(256 - levelBlend));
+				const __m128i coarseWeight = _mm_set1_epi16(static_cast<short>(levelBlend));
+				const __m128i fine = _mm_load_si128(reinterpret_cast<const __m128i*>(texels));
+				const __m128i coarse = _mm_load_si128(reinterpret_cast<const __m128i*>(coarseTexels));
+
+				const __m128i low = _mm_srli_epi16(_mm_add_epi16(
+					_mm_mullo_epi16(_mm_unpacklo_epi8(fine, zero), fineWeight),
+					_mm_mullo_epi16(_mm_unpacklo_epi8(coarse, zero), coarseWeight)), 8);
+				const __m128i high = _mm_srli_epi16(_mm_add_epi16(
+					_mm_mullo_epi16(_mm_unpackhi_epi8(fine, zero), fineWeight),
+					_mm_mullo_epi16(_mm_unpackhi_epi8(coarse, zero), coarseWeight)), 8);
+				_mm_store_si128(reinterpret_cast<__m128i*>(texels), _mm_packus_epi16(low, high));
+			}
+		}
+
+		// RGBA8 -> SoA floats
+		const __m128i packed = _mm_load_si128(reinterpret_cast<const __m128i*>(texels));
+		const __m128i channelMask = _mm_set1_epi32(0xFF);
+		const __m128 scale = _mm_set1_ps(toFloat);
+		r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, channelMask)), scale);
+		g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 8), channelMask)), scale);
+		b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 16), channelMask)), scale);
+		if constexpr (hasAlpha)
+			a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(packed, 24)), scale);
+	}
+
+	float Texture::CalculateLod(const Vector2& dUVdx, const Vector2& dUVdy) const
+	{
+		if (m_MipLevels.empty()) {
+			return 0.0f;
+		}
+
+		// Footprint of one pixel in texels, the longest axis decides
+		const float width = static_cast<float>(m_MipLevels.front().width);
+		const float height = static_cast<float>(m_MipLevels.front().height);
+		const float lengthX = Square(dUVdx.x * width) + Square(dUVdx.y * height);
+		const float lengthY = Square(dUVdy.x * width) + Square(dUVdy.y * height);
+		const float maxLength = std::max(lengthX, lengthY);
+
+		if (maxLength <= 1.0f) {
+			return 0.0f;
+		}
+
+		// log2(sqrt(x)) = 0.5 * log2(x)
+		return 0.5f * std::log2(maxLength);
+	}
+
+	void Texture::ReleaseCpuCopy()
+	{
+		// Without an uploaded copy there is nothing to read back from
+		if (!m_IsCpuResident || !m_pResource) {
+			return;
+		}
+
+		// Sizes and masks stay, only the texel storage goes
+		for (MipLevel& level : m_MipLevels)
+		{
+			std::vector<uint32_t>{}.swap(level.texels);
+			std::vector<uint8_t>{}.swap(level.blocks);
+			std::vector<uint32_t>{}.swap(level.offsetX);
+			std::vector<uint32_t>{}.swap(level.offsetY);
+			level.layout = TexelLayout::Linear;
+		}
+		m_IsCpuResident = false;
+	}
+
+	bool Texture::MakeCpuResident(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
 	{
+		if (m_IsCpuResident) {
+			return true;
+		}
+
+		// Copy into a CPU readable texture and map it level by level
+		D3D11_TEXTURE2D_DESC desc{};
+		m_pResource->GetDesc(&desc);
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		desc.MiscFlags = 0;
+
+		ID3D11Texture2D* pStaging{};
+		HRESULT hr = pDevice->CreateTexture2D(&desc, nullptr, &pStaging);
+		if (FAILED(hr)) {
+			return false;
+		}
+		pDeviceContext->CopyResource(pStaging, m_pResource);
+
+		for (UINT index = 0; index < static_cast<UINT>(m_MipLevels.size()); ++index)
+		{
+			MipLevel& level = m_MipLevels[index];
+
+			D3D11_MAPPED_SUBRESOURCE mapped{};
+			hr = pDeviceContext->Map(pStaging, index, D3D11_MAP_READ, 0, &mapped);
+			if (FAILED(hr))
+			{
+				pStaging->Release();
+				return false;
+			}
+
+			// Rows are texel rows, or block rows for compressed levels
+			const uint8_t* pSource = static_cast<const uint8_t*>(mapped.pData);
+			uint8_t* pDestination{};
+			size_t rowBytes{};
+			int rowCount{};
+			if (m_Format == TexelFormat::RGBA8)
+			{
+				level.texels.resize(static_cast<size_t>(level.width) * level.height);
+				pDestination = reinterpret_cast<uint8_t*>(level.texels.data());
+				rowBytes = static_cast<size_t>(level.width) * sizeof(uint32_t);
+				rowCount = level.height;
+			}
+			else
+			{
+				level.blocks.resize(static_cast<size_t>(level.blocksWide) * level.blocksHigh * GetBlockBytes(m_Format));
+				pDestination = level.blocks.data();
+				rowBytes = static_cast<size_t>(level.blocksWide) * GetBlockBytes(m_Format);
+				rowCount = level.blocksHigh;
+			}
+
+			for (int row = 0; row < rowCount; ++row) {
+				std::copy(pSource + row * mapped.RowPitch, pSource + row * mapped.RowPitch + rowBytes, pDestination + row * rowBytes);
+			}
+			pDeviceContext->Unmap(pStaging, index);
+		}
+		pStaging->Release();
+
+		m_IsCpuResident = true;
+		Swizzle(m_Layout);
+		return true;
+	}
+
+	size_t Texture::GetMemorySize() const
+	{
+		size_t levelBytes = 0;
+		size_t tableBytes = 0;
+		for (const MipLevel& level : m_MipLevels)
+		{
+			levelBytes += level.texels.size() * sizeof(uint32_t) + level.blocks.size();
+			tableBytes += (level.offsetX.size() + level.offsetY.size()) * sizeof(uint32_t);
+		}
+		return levelBytes + tableBytes + m_GpuBytes;
+	}
+
+	uint32_t Texture::Fetch(const MipLevel& level, int x, int y) const
+	{
+		if (m_Format != TexelFormat::RGBA8) {
+			return FetchCompressed(level, x, y);
+		}
+
+		// Wrap addressing
+		if (level.layout == TexelLayout::Morton) {
+			return level.texels[level.offsetX[x & level.widthMask] | level.offsetY[y & level.heightMask]];
+		}
+
+		if (level.isPowerOfTwo) {
+			return level.texels[((y & level.heightMask) << level.widthShift) | (x & level.widthMask)];
+		}
+
+		x %= level.width;
+		y %= level.height;
+		if (x < 0) x += level.width;
+		if (y < 0) y += level.height;
+		return level.texels[x + level.width * y];
+	}
+
+	void Texture::Fetch2x2(const MipLevel& level, int x, int y, uint32_t texels[4]) const
+	{
+		// Gather the whole footprint, the addressing of both columns and rows is shared
+		if (m_Format != TexelFormat::RGBA8)
+		{
+			texels[0] = FetchCompressed(level, x, y);
+			texels[1] = FetchCompressed(level, x + 1, y);
+			texels[2] = FetchCompressed(level, x, y + 1);
+			texels[3] = FetchCompressed(level, x + 1, y + 1);
+			return;
+		}
+
+		if (level.layout == TexelLayout::Morton)
+		{
+			const uint32_t left = level.offsetX[x & level.widthMask];
+			const uint32_t right = level.offsetX[(x + 1) & level.widthMask];
+			const uint32_t top = level.offsetY[y & level.heightMask];
+			const uint32_t bottom = level.offsetY[(y + 1) & level.heightMask];
+			texels[0] = level.texels[left | top];
+			texels[1] = level.texels[right | top];
+			texels[2] = level.texels[left | bottom];
+			texels[3] = level.texels[right | bottom];
+			return;
+		}
+
+		if (level.isPowerOfTwo)
+		{
+			const int left = x & level.widthMask;
+			const int right = (x + 1) & level.widthMask;
+			const int top = (y & level.heightMask) << level.widthShift;
+			const int bottom = ((y + 1) & level.heightMask) << level.widthShift;
+			texels[0] = level.texels[top | left];
+			texels[1] = level.texels[top | right];
+			texels[2] = level.texels[bottom | left];
+			texels[3] = level.texels[bottom | right];
+			return;
+		}
+
+		texels[0] = Fetch(level, x, y);
+		texels[1] = Fetch(level, x + 1, y);
+		texels[2] = Fetch(level, x, y + 1);
+		texels[3] = Fetch(level, x + 1, y + 1);
+	}
+
+	uint32_t Texture::FetchCompressed(const MipLevel& level, int x, int y) const
+	{
+		// Wrap addressing
+		if (level.isPowerOfTwo)
+		{
+			x &= level.widthMask;
+			y &= level.heightMask;
+		}
+		else
+		{
+			x %= level.width;
+			y %= level.height;
+			if (x < 0) x += level.width;
+			if (y < 0) y += level.height;
+		}
+
+		// Neighbouring fetches mostly land in the same block, only decode on a miss
+		const int blockBytes = GetBlockBytes(m_Format);
+		const uint8_t* pBlock = &level.blocks[static_cast<size_t>((y >> 2) * level.blocksWide + (x >> 2)) * blockBytes];
+		DecodedBlock& decoded = decodedBlocks[(reinterpret_cast<uintptr_t>(pBlock) / blockBytes) & (decodedBlockCount - 1)];
+
+		if (decoded.pBlock != pBlock || decoded.textureId != m_Id)
+		{
+			switch (m_Format)
+			{
+			case TexelFormat::BC1:
+				BlockCompression::DecodeBC1(pBlock, decoded.texels);
+				break;
+			case TexelFormat::BC3:
+				BlockCompression::DecodeBC3(pBlock, decoded.texels);
+				break;
+			case TexelFormat::BC5:
+				BlockCompression::DecodeBC5(pBlock, decoded.texels);
+				break;
+			default:
+				break;
+			}
+			decoded.pBlock = pBlock;
+			decoded.textureId = m_Id;
+		}
+
+		return decoded.texels[((y & 3) << 2) | (x & 3)];
+	}
+
+	void Texture::FetchPoint4(const MipLevel& level, __m128 u, __m128 v, uint32_t texels[4]) const
+	{
+		alignas(16) int x[4];
+		alignas(16) int y[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(x), _mm_cvtps_epi32(_mm_floor_ps(_mm_mul_ps(u, _mm_set1_ps(static_cast<float>(level.width))))));
+		_mm_store_si128(reinterpret_cast<__m128i*>(y), _mm_cvtps_epi32(_mm_floor_ps(_mm_mul_ps(v, _mm_set1_ps(static_cast<float>(level.height))))));
+
+		for (int i = 0; i < 4; ++i) {
+			texels[i] = Fetch(level, x[i], y[i]);
+		}
+	}
+
+	template<bool hasAlpha>
+	void Texture::FilterBilinear4(const MipLevel& level, __m128 u, __m128 v, uint32_t texels[4]) const
+	{
+		// Texel centers are at +0.5
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 x = _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps(static_cast<float>(level.width))), half);
+		const __m128 y = _mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps(static_cast<float>(level.height))), half);
+		const __m128 x0 = _mm_floor_ps(x);
+		const __m128 y0 = _mm_floor_ps(y);
+
+		// Only the fetches are per fragment
+		alignas(16) int ix[4];
+		alignas(16) int iy[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(ix), _mm_cvtps_epi32(x0));
+		_mm_store_si128(reinterpret_cast<__m128i*>(iy), _mm_cvtps_epi32(y0));
+
+		alignas(16) uint32_t footprints[4][4];
+		for (int i = 0; i < 4; ++i) {
+			Fetch2x2(level, ix[i], iy[i], footprints[i]);
+		}
+
+		// Fragment major to corner major: one register per corner of the 4 footprints
+		__m128 corner00 = _mm_load_ps(reinterpret_cast<const float*>(footprints[0]));
+		__m128 corner10 = _mm_load_ps(reinterpret_cast<const float*>(footprints[1]));
+		__m128 corner01 = _mm_load_ps(reinterpret_cast<const float*>(footprints[2]));
+		__m128 corner11 = _mm_load_ps(reinterpret_cast<const float*>(footprints[3]));
+		_MM_TRANSPOSE4_PS(corner00, corner10, corner01, corner11);
+		const __m128i corners[4]{ _mm_castps_si128(corner00), _mm_castps_si128(corner10), _mm_castps_si128(corner01), _mm_castps_si128(corner11) };
+
+		// Fractions as 8 bit weights (0..256), the 4 weights of a fragment always sum to 256
+		const __m128 fixedScale = _mm_set1_ps(256.0f);
+		const __m128i fx = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(x, x0), fixedScale));
+		const __m128i fy = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(y, y0), fixedScale));
+		const __m128i w11 = _mm_srli_epi32(_mm_mullo_epi32(fx, fy), 8);
+		const __m128i weights[4]{
+			_mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(_mm_set1_epi32(256), fx), fy), w11),
+			_mm_sub_epi32(fx, w11),
+			_mm_sub_epi32(fy, w11),
+			w11 };
+
+		// Channel by channel over all 4 fragments, sums stay below 2^16
+		constexpr int channelCount{ hasAlpha ? 4 : 3 };
+		const __m128i channelMask = _mm_set1_epi32(0xFF);
+		__m128i result = _mm_setzero_si128();
+		for (int shift = 0; shift < 8 * channelCount; shift += 8)
+		{
+			__m128i sum = _mm_setzero_si128();
+			for (int corner = 0; corner < 4; ++corner)
+			{
+				const __m128i channel = _mm_and_si128(_mm_srli_epi32(corners[corner], shift), channelMask);
+				sum = _mm_add_epi32(sum, _mm_mullo_epi32(channel, weights[corner]));
+			}
+			result = _mm_or_si128(result, _mm_slli_epi32(_mm_srli_epi32(sum, 8), shift));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(texels), result);
+	}
+
+	ColorRGB Texture::SampleBilinear(const MipLevel& level, float u, float v) const
+	{
+		// Texel centers are at +0.5
+		const float x = u * level.width - 0.5f;
+		const float y = v * level.height - 0.5f;
+
+		const int x0 = FloorToInt(x);
+		const int y0 = FloorToInt(y);
+		const float fx = x - static_cast<float>(x0);
+		const float fy = y - static_cast<float>(y0);
+
+		const ColorRGB topColor = ColorRGB::Lerp(ToColor(Fetch(level, x0, y0)), ToColor(Fetch(level, x0 + 1, y0)), fx);
+		const ColorRGB bottomColor = ColorRGB::Lerp(ToColor(Fetch(level, x0, y0 + 1)), ToColor(Fetch(level, x0 + 1, y0 + 1)), fx);
+		return ColorRGB::Lerp(topColor, bottomColor, fy);
+	}
+
+	Texture::MipLevel Texture::CreateMipLevel(int width, int height, bool allocateTexels)
+	{
+		MipLevel level{};
+		level.width = width;
+		level.height = height;
+		if (allocateTexels) {
+			level.texels.resize(static_cast<size_t>(width) * height);
+		}
+
+		level.isPowerOfTwo = IsPowerOfTwo(width) && IsPowerOfTwo(height);
+		if (level.isPowerOfTwo)
+		{
+			while ((1 << level.widthShift) < width) {
+				++level.widthShift;
+			}
+			level.widthMask = width - 1;
+			level.heightMask = height - 1;
+		}
+		return level;
+	}
+
+	void Texture::Convert(SDL_Surface* pSurface)
+	{
+		m_MipLevels.clear();
+		if (!pSurface) {
+			return;
+		}
+
+		// One conversion at load, the sampler never looks at the SDL format again
+		SDL_Surface* pConverted = SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_ABGR8888, 0);
+		SDL_FreeSurface(pSurface);
+		if (!pConverted) {
+			return;
+		}
+
+		MipLevel level = CreateMipLevel(pConverted->w, pConverted->h);
+
+		SDL_LockSurface(pConverted);
+		for (int y = 0; y < pConverted->h; ++y)
+		{
+			const uint32_t* pRow = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pConverted->pixels) + static_cast<size_t>(y) * pConverted->pitch);
+			std::copy(pRow, pRow + pConverted->w, level.texels.begin() + static_cast<size_t>(y) * pConverted->w);
+		}
+		SDL_UnlockSurface(pConverted);
+		SDL_FreeSurface(pConverted);
+
+		m_MipLevels.push_back(std::move(level));
+	}
+
+	void Texture::BuildMipChain()
+	{
+		if (m_MipLevels.empty()) {
+			return;
+		}
+
+		// Halve until 1x1, averaging 2x2 blocks (clamped at odd edges)
+		while (m_MipLevels.back().width > 1 || m_MipLevels.back().height > 1)
+		{
+			const MipLevel& source = m_MipLevels.back();
+			MipLevel level = CreateMipLevel(std::max(1, source.width / 2), std::max(1, source.height / 2));
+
+			for (int y = 0; y < level.height; ++y)
+			{
+				for (int x = 0; x < level.width; ++x)
+				{
+					const int x0 = std::min(x * 2, source.width - 1);
+					const int x1 = std::min(x * 2 + 1, source.width - 1);
+					const int y0 = std::min(y * 2, source.height - 1);
+					const int y1 = std::min(y * 2 + 1, source.height - 1);
+
+					const uint32_t texels[4]{
+						source.texels[x0 + source.width * y0],
+						source.texels[x1 + source.width * y0],
+						source.texels[x0 + source.width * y1],
+						source.texels[x1 + source.width * y1] };
+
+					// Rounded average per channel
+					uint32_t result = 0;
+					for (int shift = 0; shift < 32; shift += 8)
+					{
+						uint32_t sum = 2;
+						for (uint32_t texel : texels) {
+							sum += (texel >> shift) & 0xFF;
+						}
+						result |= (sum / 4) << shift;
+					}
+					level.texels[x + level.width * y] = result;
+				}
+			}
+
+			m_MipLevels.push_back(std::move(level));
+		}
+	}
+
+	bool Texture::Compress(TexelFormat format)
+	{
+		if (m_MipLevels.empty()) {
+			return false;
+		}
+
+		// D3D wants the top level in whole blocks, smaller levels are padded
+		const MipLevel& top = m_MipLevels.front();
+		if (top.width % BlockCompression::blockDimension != 0 || top.height % BlockCompression::blockDimension != 0) {
+			std::cout << "Block compression needs a multiple of 4 in size, keeping RGBA8\n";
+			return false;
+		}
+
+		const int blockBytes = GetBlockBytes(format);
+		for (MipLevel& level : m_MipLevels)
+		{
+			level.blocksWide = (level.width + 3) / 4;
+			level.blocksHigh = (level.height + 3) / 4;
+			level.blocks.resize(static_cast<size_t>(level.blocksWide) * level.blocksHigh * blockBytes);
+
+			for (int blockY = 0; blockY < level.blocksHigh; ++blockY)
+			{
+				for (int blockX = 0; blockX < level.blocksWide; ++blockX)
+				{
+					// Texels past the edge repeat the last row/column
+					uint32_t texels[16];
+					for (int i = 0; i < 16; ++i)
+					{
+						const int x = std::min(blockX * 4 + (i & 3), level.width - 1);
+						const int y = std::min(blockY * 4 + (i >> 2), level.height - 1);
+						texels[i] = level.texels[x + level.width * y];
+					}
+
+					uint8_t* pBlock = &level.blocks[static_cast<size_t>(blockY * level.blocksWide + blockX) * blockBytes];
+					switch (format)
+					{
+					case TexelFormat::BC1:
+						BlockCompression::EncodeBC1(texels, pBlock);
+						break;
+					case TexelFormat::BC3:
+						BlockCompression::EncodeBC3(texels, pBlock);
+						break;
+					case TexelFormat::BC5:
+						BlockCompression::EncodeBC5(texels, pBlock);
+						break;
+					default:
+						break;
+					}
+				}
+			}
+
+			std::vector<uint32_t>{}.swap(level.texels);
+		}
+
+		m_Format = format;
+		return true;
+	}
+
+	bool Texture::ReadCache(const std::string& cachePath, TexelFormat format)
+	{
+		// A cache older than its source is re-encoded
+		std::error_code error{};
+		const std::string sourcePath = cachePath.substr(0, cachePath.size() - 4);
+		if (!std::filesystem::exists(cachePath, error) ||
+			std::filesystem::last_write_time(cachePath, error) < std::filesystem::last_write_time(sourcePath, error)) {
+			return false;
+		}
+
+		// Nothing in the file is trusted: sizes are checked against the mip chain and the bytes that are left
+		// before anything is allocated, a corrupt cache is re-encoded instead of failing the load
+		const uintmax_t fileSize = std::filesystem::file_size(cachePath, error);
+		if (error) {
+			return false;
+		}
+
+		std::ifstream file{ cachePath, std::ios::binary };
+		CacheHeader header{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			header.magic != cacheMagic || header.version != cacheVersion || header.format != static_cast<uint32_t>(format) ||
+			header.levelCount == 0 || header.levelCount > maxCacheLevels) {
+			return false;
+		}
+
+		uintmax_t remainingBytes = fileSize - sizeof(header);
+		std::vector<MipLevel> levels{};
+		for (uint32_t index = 0; index < header.levelCount; ++index)
+		{
+			int32_t size[2]{};
+			if (remainingBytes < sizeof(size) || !file.read(reinterpret_cast<char*>(size), sizeof(size))) {
+				return false;
+			}
+			remainingBytes -= sizeof(size);
+
+			// The top level within the D3D11 limit, every other level half the one above
+			if (index == 0)
+			{
+				if (size[0] <= 0 || size[1] <= 0 || size[0] > maxCacheSize || size[1] > maxCacheSize ||
+					header.levelCount > static_cast<uint32_t>(std::bit_width(static_cast<uint32_t>(std::max(size[0], size[1]))))) {
+					return false;
+				}
+			}
+			else if (size[0] != std::max(1, levels.back().width / 2) || size[1] != std::max(1, levels.back().height / 2)) {
+				return false;
+			}
+
+			MipLevel level = CreateMipLevel(size[0], size[1], false);
+			level.blocksWide = (level.width + 3) / 4;
+			level.blocksHigh = (level.height + 3) / 4;
+			const size_t blockBytes = static_cast<size_t>(level.blocksWide) * level.blocksHigh * GetBlockBytes(format);
+			if (remainingBytes < blockBytes) {
+				return false;
+			}
+			remainingBytes -= blockBytes;
+
+			level.blocks.resize(blockBytes);
+			if (!file.read(reinterpret_cast<char*>(level.blocks.data()), static_cast<std::streamsize>(level.blocks.size()))) {
+				return false;
+			}
+			levels.push_back(std::move(level));
+		}
+
+		if (levels.empty()) {
+			return false;
+		}
+
+		m_MipLevels = std::move(levels);
+		m_Format = format;
+		return true;
+	}
+
+	void Texture::WriteCache(const std::string& cachePath) const
+	{
+		std::ofstream file{ cachePath, std::ios::binary };
+		if (!file) {
+			std::cout << "Could not write texture cache " << cachePath << "\n";
+			return;
+		}
+
+		const CacheHeader header{ cacheMagic, cacheVersion, static_cast<uint32_t>(m_Format), static_cast<uint32_t>(m_MipLevels.size()) };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const MipLevel& level : m_MipLevels)
+		{
+			const int32_t size[2]{ level.width, level.height };
+			file.write(reinterpret_cast<const char*>(size), sizeof(size));
+			file.write(reinterpret_cast<const char*>(level.blocks.data()), static_cast<std::streamsize>(level.blocks.size()));
+		}
+	}
+
+	void Texture::Swizzle(TexelLayout layout)
+	{
+		// Blocks are 4x4 tiles already
+		if (layout != TexelLayout::Morton || m_Format != TexelFormat::RGBA8) {
+			return;
+		}
+
+		for (const MipLevel& level : m_MipLevels)
+		{
+			if (!level.isPowerOfTwo) {
+				std::cout << "Morton layout needs power of two textures, keeping scanlines\n";
+				return;
+			}
+		}
+
+		for (MipLevel& level : m_MipLevels)
+		{
+			// Interleave the low bits of x and y, the longer axis keeps its remaining bits on top
+			int heightShift = 0;
+			while ((1 << heightShift) < level.height) {
+				++heightShift;
+			}
+			const int sharedBits = std::min(level.widthShift, heightShift);
+
+			level.offsetX.resize(level.width);
+			for (int x = 0; x < level.width; ++x)
+			{
+				uint32_t offset = static_cast<uint32_t>(x >> sharedBits) << (2 * sharedBits);
+				for (int bit = 0; bit < sharedBits; ++bit) {
+					offset |= ((static_cast<uint32_t>(x) >> bit) & 1u) << (2 * bit);
+				}
+				level.offsetX[x] = offset;
+			}
+
+			level.offsetY.resize(level.height);
+			for (int y = 0; y < level.height; ++y)
+			{
+				uint32_t offset = static_cast<uint32_t>(y >> sharedBits) << (2 * sharedBits);
+				for (int bit = 0; bit < sharedBits; ++bit) {
+					offset |= ((static_cast<uint32_t>(y) >> bit) & 1u) << (2 * bit + 1);
+				}
+				level.offsetY[y] = offset;
+			}
+
+			std::vector<uint32_t> swizzled(level.texels.size());
+			for (int y = 0; y < level.height; ++y)
+			{
+				for (int x = 0; x < level.width; ++x)
+				{
+					swizzled[level.offsetX[x] | level.offsetY[y]] = level.texels[x + level.width * y];
+				}
+			}
+			level.texels = std::move(swizzled);
+			level.layout = TexelLayout::Morton;
+		}
+	}
+
+	void Texture::Load(ID3D11Device* pDevice)
+	{
+		// Headless has no device, the texture then stays CPU resident for good
+		if (m_MipLevels.empty() || !pDevice) {
+			return;
+		}
+
+		// The CPU mip chain is uploaded as is, both rasterizers sample the same levels
+		const UINT mipLevels = static_cast<UINT>(m_MipLevels.size());
+
 		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		switch (m_Format)
+		{
+		case TexelFormat::BC1: format = DXGI_FORMAT_BC1_UNORM; break;
+		case TexelFormat::BC3: format = DXGI_FORMAT_BC3_UNORM; break;
+		case TexelFormat::BC5: format = DXGI_FORMAT_BC5_UNORM; break;
+		default: break;
+		}
+
 		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = pSurface->w;
-		desc.Height = pSurface->h;
-		desc.MipLevels = 1;
+		desc.Width = m_MipLevels.front().width;
+		desc.Height = m_MipLevels.front().height;
+		desc.MipLevels = mipLevels;
 		desc.ArraySize = 1;
 		desc.Format = format;
 		desc.SampleDesc.Count = 1;
@@ -68,18 +874,40 @@ namespace dae {
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initData{};
-		initData.pSysMem = pSurface->pixels;
-		initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(mipLevels);
+		for (UINT level = 0; level < mipLevels; ++level)
+		{
+			const MipLevel& mipLevel = m_MipLevels[level];
+			if (m_Format != TexelFormat::RGBA8)
+			{
+				// Pitch is one row of blocks
+				initData[level].pSysMem = mipLevel.blocks.data();
+				initData[level].SysMemPitch = static_cast<UINT>(mipLevel.blocksWide * GetBlockBytes(m_Format));
+				initData[level].SysMemSlicePitch = static_cast<UINT>(mipLevel.blocks.size());
+				continue;
+			}
+
+			initData[level].pSysMem = mipLevel.texels.data();
+			initData[level].SysMemPitch = static_cast<UINT>(mipLevel.width * sizeof(uint32_t));
+			initData[level].SysMemSlicePitch = static_cast<UINT>(mipLevel.texels.size() * sizeof(uint32_t));
+		}
 
-		HRESULT hr = pDevice->CreateTexture2D(&desc, &initData, &m_pResource);
+		HRESULT hr = pDevice->CreateTexture2D(&desc, initData.data(), &m_pResource);
+		if (FAILED(hr)) {
+			return;
+		}
+
+		m_GpuBytes = 0;
+		for (const D3D11_SUBRESOURCE_DATA& data : initData)
+		{
+			m_GpuBytes += data.SysMemSlicePitch;
+		}
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
 		SRVDesc.Format = format;
 		SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		SRVDesc.Texture2D.MipLevels = 1;
+		SRVDesc.Texture2D.MipLevels = mipLevels;
 
 		hr = pDevice->CreateShaderResourceView(m_pResource, &SRVDesc, &m_pSRV);
 	}
-}
\ No newline at end of file
+}
@@ -2,10 +2,37 @@
 #include "Math.h"
 #include <SDL_surface.h>
 #include <d3d11.h>
+#include <memory>
 #include <string>
+#include <vector>
+#include <immintrin.h>
 
 namespace dae {
 
+	// How texels are stored for the software sampler
+	enum class TexelLayout
+	{
+		Linear,	// scanlines
+		Morton	// Z-order, neighbours in u and v share cache lines (power of two textures only)
+	};
+
+	// Storage format of the mip levels, block compressed levels are decoded on demand in software
+	enum class TexelFormat
+	{
+		RGBA8,
+		BC1,	// opaque color, 4 bits per texel
+		BC3,	// color + alpha, 8 bits per texel
+		BC5		// normal map xy, 8 bits per texel
+	};
+
+	// Same order as the techniques in PosCol3D.fx (F4)
+	enum class SamplerFilter
+	{
+		Point,		// nearest texel of the nearest mip level
+		Linear,		// trilinear
+		Anisotropic	// trilinear in software
+	};
+
 	class Texture
 	{
     public:
@@ -16,20 +43,97 @@ namespace dae {
         Texture& operator=(const Texture&) = delete;
         Texture& operator=(Texture&&) noexcept = delete;
 
-        static Texture* LoadFromFile(const std::string& path, ID3D11Device* pDevice);
+        // Compressed formats are encoded once and cached next to the source as <path>.bc1/.bc3/.bc5
+        static Texture* LoadFromFile(const std::string& path, ID3D11Device* pDevice, TexelLayout layout = TexelLayout::Linear, TexelFormat format = TexelFormat::RGBA8);
+        // 1x1 texture to show while the real one is loading, texel is RGBA8 with r in the lowest byte
+        static Texture* CreatePlaceholder(ID3D11Device* pDevice, uint32_t texel = 0xFF808080);
+
         ColorRGB Sample(const Vector2& uv) const;
+        // Trilinear sample, lod 0 is the full resolution level
+        ColorRGB Sample(const Vector2& uv, float lod) const;
+
+        // Filters 4 fragments at once (SoA uv), all sampled with the same lod
+        void Sample4(__m128 u, __m128 v, float lod, SamplerFilter filter, __m128& r, __m128& g, __m128& b) const;
+        void Sample4(__m128 u, __m128 v, float lod, SamplerFilter filter, __m128& r, __m128& g, __m128& b, __m128& a) const;
+
+        // Mip level from the screen space derivatives of the uv
+        float CalculateLod(const Vector2& dUVdx, const Vector2& dUVdy) const;
+        int GetMipLevelCount() const { return static_cast<int>(m_MipLevels.size()); }
+        // CPU copy plus the uploaded copy, in bytes
+        size_t GetMemorySize() const;
 
         ID3D11ShaderResourceView* GetShaderResourceView() const { return m_pSRV; }
 
+        // Hardware rendering only needs the uploaded copy, the CPU levels come back through a GPU read back
+        void ReleaseCpuCopy();
+        bool MakeCpuResident(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
+        bool IsCpuResident() const { return m_IsCpuResident; }
+        // Source image, empty for placeholders
+        const std::string& GetPath() const { return m_Path; }
+
     private:
-        SDL_Surface* m_pSurface{};
-        uint32_t* m_pSurfacePixels{};
-        
-        ID3D11Texture2D* m_pResource; 
-        ID3D11ShaderResourceView* m_pSRV;
+        // Canonical CPU copy: RGBA8 with r in the lowest byte (same layout as DXGI_FORMAT_R8G8B8A8_UNORM)
+        struct MipLevel
+        {
+            std::vector<uint32_t> texels{};
+            int width{};
+            int height{};
+
+            // Power of two levels are addressed with shifts and masks
+            bool isPowerOfTwo{ false };
+            int widthShift{};
+            int widthMask{};
+            int heightMask{};
+
+            // Morton levels: texel index = offsetX[x] | offsetY[y]
+            TexelLayout layout{ TexelLayout::Linear };
+            std::vector<uint32_t> offsetX{};
+            std::vector<uint32_t> offsetY{};
+
+            // Compressed levels replace the texels with 4x4 blocks (scanline order, edges padded)
+            std::vector<uint8_t> blocks{};
+            int blocksWide{};
+            int blocksHigh{};
+        };
+
+        // Level 0 is the full resolution, every next level halves the size (box filtered)
+        std::vector<MipLevel> m_MipLevels{};
+        TexelFormat m_Format{ TexelFormat::RGBA8 };
+        TexelLayout m_Layout{ TexelLayout::Linear };
+        bool m_IsCpuResident{ true };
+
+        // Tags this texture's blocks in the per-thread decode cache
+        uint32_t m_Id{};
+        std::string m_Path{};
+
+        ID3D11Texture2D* m_pResource{};
+        ID3D11ShaderResourceView* m_pSRV{};
+        // Bytes uploaded to m_pResource, the CPU levels may be released since
+        size_t m_GpuBytes{};
 
         // private functions
-        Texture(SDL_Surface* pSurface, ID3D11Device* pDevice);
-        void Load(const SDL_Surface* pSurface, ID3D11Device* pDevice);
+        Texture(const std::string& path, ID3D11Device* pDevice, TexelLayout layout, TexelFormat format);
+        Texture(uint32_t texel, ID3D11Device* pDevice);
+        void Convert(SDL_Surface* pSurface);
+        void BuildMipChain();
+        bool Compress(TexelFormat format);
+        bool ReadCache(const std::string& cachePath, TexelFormat format);
+        void WriteCache(const std::string& cachePath) const;
+        void Load(ID3D11Device* pDevice);
+        void Swizzle(TexelLayout layout);
+
+        static MipLevel CreateMipLevel(int width, int height, bool allocateTexels = true);
+        uint32_t Fetch(const MipLevel& level, int x, int y) const;
+        uint32_t FetchCompressed(const MipLevel& level, int x, int y) const;
+        void Fetch2x2(const MipLevel& level, int x, int y, uint32_t texels[4]) const;
+        void FetchPoint4(const MipLevel& level, __m128 u, __m128 v, uint32_t texels[4]) const;
+        // Opaque samples leave the alpha byte zero and never convert it
+        template<bool hasAlpha>
+        void SampleChannels4(__m128 u, __m128 v, float lod, SamplerFilter filter, __m128& r, __m128& g, __m128& b, __m128& a) const;
+        template<bool hasAlpha>
+        void FilterBilinear4(const MipLevel& level, __m128 u, __m128 v, uint32_t texels[4]) const;
+        ColorRGB SampleBilinear(const MipLevel& level, float u, float v) const;
 	};
+
+	using TextureHandle = std::shared_ptr<Texture>;
 };
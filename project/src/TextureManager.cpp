@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "TextureManager.h"
+#include "ThreadPool.h"
+#include <fstream>
+
+namespace dae
+{
+	TextureManager::TextureManager(ID3D11Device* pDevice, ThreadPool& loaderPool, size_t memoryBudget) :
+		m_pDevice{ pDevice },
+		m_LoaderPool{ loaderPool },
+		m_MemoryBudget{ memoryBudget },
+		m_pPlaceholder{ Texture::CreatePlaceholder(pDevice) }
+	{
+	}
+
+	TextureManager::~TextureManager()
+	{
+		// Workers still reference the content index
+		for (auto& [key, entry] : m_Entries)
+		{
+			entry.texture.wait();
+		}
+	}
+
+	std::shared_future<TextureHandle> TextureManager::LoadAsync(const std::string& path, TexelLayout layout, TexelFormat format)
+	{
+		const std::string key{ MakeKey(path, layout, format) };
+
+		const auto it{ m_Entries.find(key) };
+		if (it != m_Entries.end())
+		{
+			m_LruKeys.splice(m_LruKeys.begin(), m_LruKeys, it->second.lruPosition);
+			return it->second.texture;
+		}
+
+		ID3D11Device* pDevice{ m_pDevice };
+		std::shared_future<TextureHandle> texture{ m_LoaderPool.Submit([this, path, pDevice, layout, format]() -> TextureHandle
+			{
+				// Same bytes loaded with the same settings share one texture
+				const uint64_t contentKey{ HashFile(path) ^ (static_cast<uint64_t>(layout) << 56) ^ (static_cast<uint64_t>(format) << 60) };
+				{
+					std::lock_guard<std::mutex> lock{ m_ContentMutex };
+					const auto content{ m_ContentIndex.find(contentKey) };
+					if (content != m_ContentIndex.end())
+					{
+						if (TextureHandle pExisting{ content->second.lock() })
+							return pExisting;
+					}
+				}
+
+				TextureHandle pTexture{ Texture::LoadFromFile(path, pDevice, layout, format) };
+
+				std::lock_guard<std::mutex> lock{ m_ContentMutex };
+				m_ContentIndex[contentKey] = pTexture;
+				return pTexture;
+			}).share() };
+
+		m_LruKeys.push_front(key);
+		m_Entries.emplace(key, CacheEntry{ texture, m_LruKeys.begin() });
+		return texture;
+	}
+
+	TextureHandle TextureManager::Load(const std::string& path, TexelLayout layout, TexelFormat format)
+	{
+		return LoadAsync(path, layout, format).get();
+	}
+
+	void TextureManager::Trim()
+	{
+		size_t usage{ GetMemoryUsage() };
+
+		// Deduplicated textures are held by several entries, only references beyond those are users
+		std::unordered_map<const Texture*, long> cacheReferences{ CountCacheReferences() };
+
+		// Walk from the least recently used end, skipping loads in flight and textures still referenced elsewhere
+		for (auto it = m_LruKeys.end(); it != m_LruKeys.begin() && usage > m_MemoryBudget;)
+		{
+			--it;
+			const auto entry{ m_Entries.find(*it) };
+			if (!IsReady(entry->second.texture))
+				continue;
+
+			const TextureHandle& pTexture{ entry->second.texture.get() };
+			const Texture* pKey{ pTexture.get() };
+			if (pTexture.use_count() > cacheReferences[pKey])
+				continue;
+
+			// Memory only comes back with the last entry holding it
+			const size_t memorySize{ pTexture->GetMemorySize() };
+			if (--cacheReferences[pKey] == 0)
+				usage -= memorySize;
+
+			m_Entries.erase(entry);
+			it = m_LruKeys.erase(it);
+		}
+
+		// Drop index entries of textures that are gone
+		std::lock_guard<std::mutex> lock{ m_ContentMutex };
+		std::erase_if(m_ContentIndex, [](const auto& content) { return content.second.expired(); });
+	}
+
+	size_t TextureManager::GetMemoryUsage() const
+	{
+		// Every texture once, however many entries share it
+		size_t usage{};
+		for (const auto& [pTexture, references] : CountCacheReferences())
+		{
+			usage += pTexture->GetMemorySize();
+		}
+		return usage;
+	}
+
+	std::unordered_map<const Texture*, long> TextureManager::CountCacheReferences() const
+	{
+		std::unordered_map<const Texture*, long> cacheReferences{};
+		for (const auto& [key, entry] : m_Entries)
+		{
+			if (IsReady(entry.texture))
+				++cacheReferences[entry.texture.get().get()];
+		}
+		return cacheReferences;
+	}
+
+	std::string TextureManager::MakeKey(const std::string& path, TexelLayout layout, TexelFormat format)
+	{
+		return path + '|' + std::to_string(static_cast<int>(layout)) + '|' + std::to_string(static_cast<int>(format));
+	}
+
+	uint64_t TextureManager::HashFile(const std::string& path)
+	{
+		// FNV-1a over the file bytes
+		std::ifstream file{ path, std::ios::binary };
+		uint64_t hash{ 14695981039346656037ull };
+
+		char buffer[4096];
+		while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+		{
+			for (std::streamsize i = 0; i < file.gcount(); ++i)
+			{
+				hash ^= static_cast<uint8_t>(buffer[i]);
+				hash *= 1099511628211ull;
+			}
+		}
+		return hash;
+	}
+
+	bool TextureManager::IsReady(const std::shared_future<TextureHandle>& texture)
+	{
+		return texture.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+}
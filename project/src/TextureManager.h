@@ -0,0 +1,63 @@
+#pragma once
+#include "Texture.h"
+#include <future>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace dae
+{
+	class ThreadPool;
+
+	// Shared texture cache: one texture per path (and per file content), unused ones are evicted least recently used first.
+	// Only called from the main thread, the workers just decode.
+	class TextureManager final
+	{
+	public:
+		static constexpr size_t defaultMemoryBudget{ 256ull * 1024 * 1024 };
+
+		TextureManager(ID3D11Device* pDevice, ThreadPool& loaderPool, size_t memoryBudget = defaultMemoryBudget);
+		~TextureManager();
+
+		TextureManager(const TextureManager&) = delete;
+		TextureManager(TextureManager&&) noexcept = delete;
+		TextureManager& operator=(const TextureManager&) = delete;
+		TextureManager& operator=(TextureManager&&) noexcept = delete;
+
+		std::shared_future<TextureHandle> LoadAsync(const std::string& path, TexelLayout layout = TexelLayout::Linear, TexelFormat format = TexelFormat::RGBA8);
+		TextureHandle Load(const std::string& path, TexelLayout layout = TexelLayout::Linear, TexelFormat format = TexelFormat::RGBA8);
+		const TextureHandle& GetPlaceholder() const { return m_pPlaceholder; }
+
+		// Evicts textures only the cache still holds until the loaded ones fit the budget
+		void Trim();
+		void SetMemoryBudget(size_t bytes) { m_MemoryBudget = bytes; }
+		size_t GetMemoryUsage() const;
+
+	private:
+		struct CacheEntry
+		{
+			std::shared_future<TextureHandle> texture{};
+			std::list<std::string>::iterator lruPosition{};
+		};
+
+		ID3D11Device* m_pDevice{};
+		ThreadPool& m_LoaderPool;
+		size_t m_MemoryBudget{};
+
+		TextureHandle m_pPlaceholder{};
+
+		// Keyed on path + layout + format, most recently used at the front of the list
+		std::unordered_map<std::string, CacheEntry> m_Entries{};
+		std::list<std::string> m_LruKeys{};
+
+		// Identical files under different paths, filled in by the workers
+		std::unordered_map<uint64_t, std::weak_ptr<Texture>> m_ContentIndex{};
+		std::mutex m_ContentMutex{};
+
+		// Cache entries per distinct texture (ready ones only)
+		std::unordered_map<const Texture*, long> CountCacheReferences() const;
+		static std::string MakeKey(const std::string& path, TexelLayout layout, TexelFormat format);
+		static uint64_t HashFile(const std::string& path);
+		static bool IsReady(const std::shared_future<TextureHandle>& texture);
+	};
+}
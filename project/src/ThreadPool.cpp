@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	ThreadPool::ThreadPool(size_t threadCount)
+	{
+		if (threadCount == 0)
+		{
+			const size_t cores{ std::thread::hardware_concurrency() };
+			threadCount = cores > 1 ? cores - 1 : 1;
+		}
+
+		m_Workers.reserve(threadCount);
+		for (size_t i = 0; i < threadCount; ++i)
+		{
+			m_Workers.emplace_back([this]() { WorkerLoop(); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		// Queued tasks still run, their futures may be waited on
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_TaskAvailable.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task{};
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_TaskAvailable.wait(lock, [this]() { return m_IsStopping || !m_Tasks.empty(); });
+
+				if (m_Tasks.empty())
+					return;
+
+				task = std::move(m_Tasks.front());
+				m_Tasks.pop();
+			}
+			task();
+		}
+	}
+}
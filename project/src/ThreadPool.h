@@ -0,0 +1,54 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+	// Fixed set of workers pulling tasks from one queue, results come back as futures
+	class ThreadPool final
+	{
+	public:
+		// 0 threads -> one per core, minus the main thread
+		explicit ThreadPool(size_t threadCount = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		template<typename Task>
+		std::future<std::invoke_result_t<Task>> Submit(Task&& task)
+		{
+			using Result = std::invoke_result_t<Task>;
+
+			// std::function needs a copyable target, so the packaged task is shared
+			auto pPackagedTask{ std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task)) };
+			std::future<Result> result{ pPackagedTask->get_future() };
+			{
+				std::lock_guard<std::mutex> lock{ m_Mutex };
+				m_Tasks.emplace([pPackagedTask]() { (*pPackagedTask)(); });
+			}
+			m_TaskAvailable.notify_one();
+			return result;
+		}
+
+		size_t GetThreadCount() const { return m_Workers.size(); }
+
+	private:
+		std::vector<std::thread> m_Workers{};
+		std::queue<std::function<void()>> m_Tasks{};
+		std::mutex m_Mutex{};
+		std::condition_variable m_TaskAvailable{};
+		bool m_IsStopping{ false };
+
+		void WorkerLoop();
+	};
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include <fstream>
+#include <map>
+#include <tuple>
+#include <unordered_map>
 #include "Math.h"
 
 namespace dae
@@ -19,6 +22,9 @@ namespace dae
 			std::vector<Vector3> normals{};
 			std::vector<Vector2> UVs{};
 
+			// Corners that share position, uv and normal become one vertex
+			std::map<std::tuple<size_t, size_t, size_t>, uint32_t> uniqueVertices{};
+
 			vertices.clear();
 			indices.clear();
 
@@ -64,7 +70,7 @@ namespace dae
 					//
 					// Faces or triangles
 					Vertex_PosCol vertex{};
-					size_t iPosition, iTexCoord, iNormal;
+					size_t iPosition{}, iTexCoord{}, iNormal{};
 
 					uint32_t tempIndices[3];
 					for (size_t iFace = 0; iFace < 3; iFace++)
@@ -94,9 +100,19 @@ namespace dae
 							}
 						}
 
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
-						indices.push_back(uint32_t(vertices.size()) - 1);
+						const auto key{ std::make_tuple(iPosition, iTexCoord, iNormal) };
+						const auto it{ uniqueVertices.find(key) };
+						if (it != uniqueVertices.end())
+						{
+							tempIndices[iFace] = it->second;
+						}
+						else
+						{
+							vertices.push_back(vertex);
+							tempIndices[iFace] = uint32_t(vertices.size()) - 1;
+							uniqueVertices.emplace(key, tempIndices[iFace]);
+						}
+						indices.push_back(tempIndices[iFace]);
 					}
 
 					indices.push_back(tempIndices[0]);
@@ -158,6 +174,145 @@ namespace dae
 
 			return true;
 		}
+
+		//Converts a triangle list into a single triangle strip.
+		//Strips are grown greedily over shared edges and joined with degenerate triangles,
+		//the winding of every source triangle is preserved (odd strip triangles are read as (i+1, i, i+2))
+		static void StripifyTriangleList(const std::vector<uint32_t>& listIndices, std::vector<uint32_t>& stripIndices)
+		{
+			stripIndices.clear();
+
+			const uint32_t triangleCount{ static_cast<uint32_t>(listIndices.size() / 3) };
+			if (triangleCount == 0)
+				return;
+
+			auto edgeKey = [](uint32_t a, uint32_t b)
+				{
+					if (a > b) std::swap(a, b);
+					return (static_cast<uint64_t>(a) << 32) | b;
+				};
+
+			// Edge -> triangles that use it
+			std::unordered_map<uint64_t, std::vector<uint32_t>> edgeTriangles{};
+			edgeTriangles.reserve(listIndices.size());
+			for (uint32_t t = 0; t < triangleCount; ++t)
+			{
+				const uint32_t* tri{ &listIndices[size_t(t) * 3] };
+				edgeTriangles[edgeKey(tri[0], tri[1])].push_back(t);
+				edgeTriangles[edgeKey(tri[1], tri[2])].push_back(t);
+				edgeTriangles[edgeKey(tri[2], tri[0])].push_back(t);
+			}
+
+			// Start from the least connected triangles, they are the hardest to pick up later
+			std::vector<uint32_t> startOrder(triangleCount);
+			std::vector<uint32_t> degree(triangleCount);
+			for (uint32_t t = 0; t < triangleCount; ++t)
+			{
+				const uint32_t* tri{ &listIndices[size_t(t) * 3] };
+				startOrder[t] = t;
+				degree[t] = static_cast<uint32_t>(edgeTriangles[edgeKey(tri[0], tri[1])].size() +
+					edgeTriangles[edgeKey(tri[1], tri[2])].size() +
+					edgeTriangles[edgeKey(tri[2], tri[0])].size());
+			}
+			std::stable_sort(startOrder.begin(), startOrder.end(), [&degree](uint32_t a, uint32_t b) { return degree[a] < degree[b]; });
+
+			auto hasWinding = [&listIndices](uint32_t t, uint32_t a, uint32_t b, uint32_t c)
+				{
+					const uint32_t* tri{ &listIndices[size_t(t) * 3] };
+					return (tri[0] == a && tri[1] == b && tri[2] == c) ||
+						(tri[1] == a && tri[2] == b && tri[0] == c) ||
+						(tri[2] == a && tri[0] == b && tri[1] == c);
+				};
+
+			std::vector<bool> used(triangleCount, false);
+			// Triangles claimed by the strip currently being grown (stamped per attempt)
+			std::vector<uint32_t> claimed(triangleCount, 0);
+			uint32_t attempt{ 0 };
+
+			std::vector<uint32_t> strip{};
+			std::vector<uint32_t> bestStrip{};
+			std::vector<uint32_t> stripTriangles{};
+			std::vector<uint32_t> bestStripTriangles{};
+
+			for (uint32_t start : startOrder)
+			{
+				if (used[start])
+					continue;
+
+				const uint32_t* startTri{ &listIndices[size_t(start) * 3] };
+				bestStrip.clear();
+				bestStripTriangles.clear();
+
+				// Try every rotation of the start triangle and keep the longest strip
+				for (uint32_t rotation = 0; rotation < 3; ++rotation)
+				{
+					++attempt;
+					strip = { startTri[rotation], startTri[(rotation + 1) % 3], startTri[(rotation + 2) % 3] };
+					stripTriangles = { start };
+					claimed[start] = attempt;
+
+					while (true)
+					{
+						const size_t n{ strip.size() };
+						const uint32_t a{ strip[n - 2] };
+						const uint32_t b{ strip[n - 1] };
+						const bool oddTriangle{ ((n - 2) & 1) != 0 };
+
+						const auto it{ edgeTriangles.find(edgeKey(a, b)) };
+						bool extended{ false };
+						for (uint32_t candidate : it->second)
+						{
+							if (used[candidate] || claimed[candidate] == attempt)
+								continue;
+
+							const uint32_t* tri{ &listIndices[size_t(candidate) * 3] };
+							uint32_t next{ tri[0] };
+							if (next == a || next == b) next = tri[1];
+							if (next == a || next == b) next = tri[2];
+							if (next == a || next == b)
+								continue;
+
+							const bool matches{ oddTriangle ? hasWinding(candidate, b, a, next) : hasWinding(candidate, a, b, next) };
+							if (!matches)
+								continue;
+
+							strip.push_back(next);
+							stripTriangles.push_back(candidate);
+							claimed[candidate] = attempt;
+							extended = true;
+							break;
+						}
+
+						if (!extended)
+							break;
+					}
+
+					if (strip.size() > bestStrip.size())
+					{
+						std::swap(bestStrip, strip);
+						std::swap(bestStripTriangles, stripTriangles);
+					}
+				}
+
+				for (uint32_t t : bestStripTriangles)
+				{
+					used[t] = true;
+				}
+
+				// Join with degenerates, the new strip has to start on an even triangle to keep its winding
+				if (!stripIndices.empty())
+				{
+					const bool oddLength{ (stripIndices.size() & 1) != 0 };
+					stripIndices.push_back(stripIndices.back());
+					stripIndices.push_back(bestStrip.front());
+					if (oddLength)
+					{
+						stripIndices.push_back(bestStrip.front());
+					}
+				}
+				stripIndices.insert(stripIndices.end(), bestStrip.begin(), bestStrip.end());
+			}
+		}
 #pragma warning(pop)
 	}
 }
\ No newline at end of file
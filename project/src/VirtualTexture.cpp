@@ -0,0 +1,499 @@
+#include "pch.h"
+#include "VirtualTexture.h"
+#include "ThreadPool.h"
+#include <SDL_image.h>
+#include <filesystem>
+#include <fstream>
+
+namespace dae
+{
+	namespace
+	{
+		// Page file: header, one entry per level, then every page of every level (RGBA8, edges padded)
+		struct PageFileHeader
+		{
+			uint32_t magic{};
+			uint32_t version{};
+			uint32_t width{};
+			uint32_t height{};
+			uint32_t pageSize{};
+			uint32_t levelCount{};
+		};
+
+		struct PageFileLevel
+		{
+			uint32_t width{};
+			uint32_t height{};
+			uint32_t pagesWide{};
+			uint32_t pagesHigh{};
+		};
+
+		constexpr uint32_t pageFileMagic{ 0x58455456 }; // "VTEX"
+		constexpr uint32_t pageFileVersion{ 1 };
+		// Larger sources would not fit in memory for BuildPageFile anyway, halving that down to a page takes 10 levels
+		constexpr uint32_t maxPageFileSize{ 65536 };
+		constexpr uint32_t maxPageFileLevels{ 10 };
+		constexpr size_t pageTexelCount{ static_cast<size_t>(VirtualTexture::pageSize) * VirtualTexture::pageSize };
+		constexpr uint32_t missingPageTexel{ 0xFFFF00FF };
+
+		inline int FloorToInt(float value)
+		{
+			const int truncated = static_cast<int>(value);
+			return truncated - (value < static_cast<float>(truncated) ? 1 : 0);
+		}
+
+		inline int Wrap(int value, int size)
+		{
+			value %= size;
+			return value < 0 ? value + size : value;
+		}
+
+		inline int PageCount(int size)
+		{
+			return (size + VirtualTexture::pageSize - 1) / VirtualTexture::pageSize;
+		}
+
+		// Weights sum to 256, same as the Texture kernel
+		uint32_t BlendBilinear(const uint32_t texels[4], int fx, int fy)
+		{
+			const int w11 = (fx * fy) >> 8;
+			const int w10 = fx - w11;
+			const int w01 = fy - w11;
+			const int w00 = 256 - fx - fy + w11;
+
+			uint32_t result = 0;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				const uint32_t sum =
+					((texels[0] >> shift) & 0xFF) * w00 +
+					((texels[1] >> shift) & 0xFF) * w10 +
+					((texels[2] >> shift) & 0xFF) * w01 +
+					((texels[3] >> shift) & 0xFF) * w11;
+				result |= (sum >> 8) << shift;
+			}
+			return result;
+		}
+	}
+
+	VirtualTexture::VirtualTexture(const std::string& pageFilePath, ThreadPool& loaderPool) :
+		m_PageFilePath{ pageFilePath },
+		m_LoaderPool{ loaderPool }
+	{
+	}
+
+	VirtualTexture::~VirtualTexture()
+	{
+		// Workers write into m_LoadedPages
+		for (std::future<void>& load : m_Loads)
+		{
+			load.wait();
+		}
+	}
+
+	bool VirtualTexture::BuildPageFile(const std::string& imagePath, const std::string& pageFilePath)
+	{
+		SDL_Surface* pLoaded = IMG_Load(imagePath.c_str());
+		if (!pLoaded) {
+			return false;
+		}
+		SDL_Surface* pSurface = SDL_ConvertSurfaceFormat(pLoaded, SDL_PIXELFORMAT_ABGR8888, 0);
+		SDL_FreeSurface(pLoaded);
+		if (!pSurface) {
+			return false;
+		}
+
+		int width = pSurface->w;
+		int height = pSurface->h;
+		std::vector<uint32_t> texels(static_cast<size_t>(width) * height);
+
+		SDL_LockSurface(pSurface);
+		for (int y = 0; y < height; ++y)
+		{
+			const uint32_t* pRow = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pSurface->pixels) + static_cast<size_t>(y) * pSurface->pitch);
+			std::copy(pRow, pRow + width, texels.begin() + static_cast<size_t>(y) * width);
+		}
+		SDL_UnlockSurface(pSurface);
+		SDL_FreeSurface(pSurface);
+
+		// Halve until a level fits in one page
+		std::vector<PageFileLevel> levels{};
+		for (int levelWidth = width, levelHeight = height;;)
+		{
+			levels.push_back({ static_cast<uint32_t>(levelWidth), static_cast<uint32_t>(levelHeight),
+				static_cast<uint32_t>(PageCount(levelWidth)), static_cast<uint32_t>(PageCount(levelHeight)) });
+			if (levelWidth <= pageSize && levelHeight <= pageSize)
+				break;
+			levelWidth = std::max(1, levelWidth / 2);
+			levelHeight = std::max(1, levelHeight / 2);
+		}
+
+		std::ofstream file{ pageFilePath, std::ios::binary };
+		if (!file) {
+			return false;
+		}
+
+		const PageFileHeader header{ pageFileMagic, pageFileVersion, static_cast<uint32_t>(width), static_cast<uint32_t>(height), pageSize, static_cast<uint32_t>(levels.size()) };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(levels.size() * sizeof(PageFileLevel)));
+
+		std::vector<uint32_t> page(pageTexelCount);
+		for (size_t levelIndex = 0; levelIndex < levels.size(); ++levelIndex)
+		{
+			const PageFileLevel& level = levels[levelIndex];
+			for (uint32_t pageY = 0; pageY < level.pagesHigh; ++pageY)
+			{
+				for (uint32_t pageX = 0; pageX < level.pagesWide; ++pageX)
+				{
+					// Texels past the edge repeat the last row/column
+					for (int y = 0; y < pageSize; ++y)
+					{
+						const int sourceY = std::min(static_cast<int>(pageY) * pageSize + y, height - 1);
+						for (int x = 0; x < pageSize; ++x)
+						{
+							const int sourceX = std::min(static_cast<int>(pageX) * pageSize + x, width - 1);
+							page[x + y * pageSize] = texels[sourceX + static_cast<size_t>(width) * sourceY];
+						}
+					}
+					file.write(reinterpret_cast<const char*>(page.data()), static_cast<std::streamsize>(pageTexelCount * sizeof(uint32_t)));
+				}
+			}
+
+			if (levelIndex + 1 == levels.size())
+				break;
+
+			// Rounded 2x2 box filter, clamped at odd edges
+			const int nextWidth = static_cast<int>(levels[levelIndex + 1].width);
+			const int nextHeight = static_cast<int>(levels[levelIndex + 1].height);
+			std::vector<uint32_t> next(static_cast<size_t>(nextWidth) * nextHeight);
+			for (int y = 0; y < nextHeight; ++y)
+			{
+				for (int x = 0; x < nextWidth; ++x)
+				{
+					const int x0 = std::min(x * 2, width - 1);
+					const int x1 = std::min(x * 2 + 1, width - 1);
+					const int y0 = std::min(y * 2, height - 1);
+					const int y1 = std::min(y * 2 + 1, height - 1);
+					const uint32_t quad[4]{
+						texels[x0 + static_cast<size_t>(width) * y0],
+						texels[x1 + static_cast<size_t>(width) * y0],
+						texels[x0 + static_cast<size_t>(width) * y1],
+						texels[x1 + static_cast<size_t>(width) * y1] };
+
+					uint32_t result = 0;
+					for (int shift = 0; shift < 32; shift += 8)
+					{
+						uint32_t sum = 2;
+						for (uint32_t texel : quad) {
+							sum += (texel >> shift) & 0xFF;
+						}
+						result |= (sum / 4) << shift;
+					}
+					next[x + static_cast<size_t>(nextWidth) * y] = result;
+				}
+			}
+			texels = std::move(next);
+			width = nextWidth;
+			height = nextHeight;
+		}
+
+		return static_cast<bool>(file);
+	}
+
+	VirtualTexture* VirtualTexture::Open(const std::string& pageFilePath, ThreadPool& loaderPool, size_t residentPageCount)
+	{
+		VirtualTexture* pTexture = new VirtualTexture{ pageFilePath, loaderPool };
+		if (!pTexture->ReadHeader(residentPageCount))
+		{
+			std::cout << "Could not open virtual texture " << pageFilePath << "\n";
+			delete pTexture;
+			return nullptr;
+		}
+		return pTexture;
+	}
+
+	bool VirtualTexture::ReadHeader(size_t residentPageCount)
+	{
+		// Nothing in the file is trusted: the levels have to be the chain BuildPageFile writes for the size in the
+		// header, and the file has to hold exactly their pages, before anything is allocated
+		std::error_code error{};
+		const uintmax_t fileSize = std::filesystem::file_size(m_PageFilePath, error);
+		if (error) {
+			return false;
+		}
+
+		std::ifstream file{ m_PageFilePath, std::ios::binary };
+		PageFileHeader header{};
+		if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			header.magic != pageFileMagic || header.version != pageFileVersion || header.pageSize != pageSize ||
+			header.width == 0 || header.height == 0 || header.width > maxPageFileSize || header.height > maxPageFileSize ||
+			header.levelCount == 0 || header.levelCount > maxPageFileLevels) {
+			return false;
+		}
+
+		std::vector<PageFileLevel> levels(header.levelCount);
+		m_DataOffset = sizeof(header) + levels.size() * sizeof(PageFileLevel);
+		if (fileSize < m_DataOffset ||
+			!file.read(reinterpret_cast<char*>(levels.data()), static_cast<std::streamsize>(levels.size() * sizeof(PageFileLevel)))) {
+			return false;
+		}
+
+		uint32_t levelWidth = header.width;
+		uint32_t levelHeight = header.height;
+		uint64_t filePageCount = 0;
+		for (size_t index = 0; index < levels.size(); ++index)
+		{
+			// Halved from the header size, only the last level fits in one page
+			const PageFileLevel& fileLevel = levels[index];
+			const bool isLast = index + 1 == levels.size();
+			const bool fitsInPage = levelWidth <= pageSize && levelHeight <= pageSize;
+			if (fileLevel.width != levelWidth || fileLevel.height != levelHeight || fitsInPage != isLast ||
+				fileLevel.pagesWide != static_cast<uint32_t>(PageCount(static_cast<int>(levelWidth))) ||
+				fileLevel.pagesHigh != static_cast<uint32_t>(PageCount(static_cast<int>(levelHeight)))) {
+				return false;
+			}
+
+			filePageCount += static_cast<uint64_t>(fileLevel.pagesWide) * fileLevel.pagesHigh;
+			levelWidth = std::max(1u, levelWidth / 2);
+			levelHeight = std::max(1u, levelHeight / 2);
+		}
+
+		if (fileSize - m_DataOffset != filePageCount * pageTexelCount * sizeof(uint32_t)) {
+			return false;
+		}
+
+		uint32_t pageCount = 0;
+		for (const PageFileLevel& fileLevel : levels)
+		{
+			Level level{};
+			level.width = static_cast<int>(fileLevel.width);
+			level.height = static_cast<int>(fileLevel.height);
+			level.pagesWide = static_cast<int>(fileLevel.pagesWide);
+			level.pagesHigh = static_cast<int>(fileLevel.pagesHigh);
+			level.firstPage = pageCount;
+			pageCount += fileLevel.pagesWide * fileLevel.pagesHigh;
+			m_Levels.push_back(level);
+		}
+
+		m_PageTable.assign(pageCount, -1);
+		m_IsRequested.assign(pageCount, false);
+
+		// The coarsest level is the fallback for every miss, so it never leaves
+		const Level& top = m_Levels.back();
+		const uint32_t topPageCount = static_cast<uint32_t>(top.pagesWide * top.pagesHigh);
+		m_Slots.resize(std::max<size_t>(residentPageCount, topPageCount + 1));
+
+		std::vector<uint32_t> texels{};
+		for (uint32_t page = top.firstPage; page < top.firstPage + topPageCount; ++page)
+		{
+			if (!ReadPage(page, texels)) {
+				return false;
+			}
+			Install(page, texels, true);
+		}
+		return true;
+	}
+
+	bool VirtualTexture::ReadPage(uint32_t page, std::vector<uint32_t>& texels) const
+	{
+		// Runs on the loader workers, every call opens its own stream
+		std::ifstream file{ m_PageFilePath, std::ios::binary };
+		file.seekg(static_cast<std::streamoff>(m_DataOffset + static_cast<size_t>(page) * pageTexelCount * sizeof(uint32_t)));
+
+		texels.resize(pageTexelCount);
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(texels.data()), static_cast<std::streamsize>(pageTexelCount * sizeof(uint32_t))));
+	}
+
+	void VirtualTexture::Install(uint32_t page, std::vector<uint32_t>& texels, bool isPinned)
+	{
+		// A free slot, otherwise the least recently sampled unpinned page makes room
+		int32_t slotIndex = -1;
+		for (size_t i = 0; i < m_Slots.size(); ++i)
+		{
+			const Slot& slot = m_Slots[i];
+			if (slot.page == invalidPage)
+			{
+				slotIndex = static_cast<int32_t>(i);
+				break;
+			}
+			if (!slot.isPinned && (slotIndex < 0 || slot.lastUse < m_Slots[slotIndex].lastUse)) {
+				slotIndex = static_cast<int32_t>(i);
+			}
+		}
+		if (slotIndex < 0) {
+			return;
+		}
+
+		Slot& slot = m_Slots[slotIndex];
+		if (slot.page != invalidPage) {
+			m_PageTable[slot.page] = -1;
+		}
+
+		slot.texels.swap(texels);
+		slot.page = page;
+		slot.lastUse = m_Frame;
+		slot.isPinned = isPinned;
+		m_PageTable[page] = slotIndex;
+	}
+
+	bool VirtualTexture::Update()
+	{
+		++m_Frame;
+
+		std::vector<LoadedPage> loadedPages{};
+		{
+			std::lock_guard<std::mutex> lock{ m_LoadedMutex };
+			loadedPages.swap(m_LoadedPages);
+		}
+		for (LoadedPage& loaded : loadedPages)
+		{
+			Install(loaded.page, loaded.texels, false);
+			m_IsRequested[loaded.page] = false;
+		}
+
+		std::erase_if(m_Loads, [](const std::future<void>& load) { return load.wait_for(std::chrono::seconds(0)) == std::future_status::ready; });
+
+		// Misses that don't fit in flight are dropped and come back through next frame's feedback
+		for (uint32_t page : m_Feedback)
+		{
+			if (m_Loads.size() >= static_cast<size_t>(maxPagesInFlight))
+			{
+				m_IsRequested[page] = false;
+				continue;
+			}
+
+			m_Loads.push_back(m_LoaderPool.Submit([this, page]()
+				{
+					LoadedPage loaded{ page, {} };
+					if (!ReadPage(page, loaded.texels)) {
+						loaded.texels.assign(pageTexelCount, missingPageTexel);
+					}
+
+					std::lock_guard<std::mutex> lock{ m_LoadedMutex };
+					m_LoadedPages.push_back(std::move(loaded));
+				}));
+		}
+		m_Feedback.clear();
+		return !loadedPages.empty();
+	}
+
+	void VirtualTexture::Sample4(__m128 u, __m128 v, float lod, SamplerFilter filter, __m128& r, __m128& g, __m128& b)
+	{
+		const float maxLod = static_cast<float>(m_Levels.size() - 1);
+		lod = Clamp(lod, 0.0f, maxLod);
+		const int level = filter == SamplerFilter::Point ? static_cast<int>(lod + 0.5f) : static_cast<int>(lod);
+
+		alignas(16) float us[4];
+		alignas(16) float vs[4];
+		alignas(16) uint32_t texels[4];
+		_mm_store_ps(us, u);
+		_mm_store_ps(vs, v);
+		for (int i = 0; i < 4; ++i) {
+			texels[i] = SampleTexel(us[i], vs[i], level, filter);
+		}
+
+		// RGBA8 -> SoA floats
+		const __m128i packed = _mm_load_si128(reinterpret_cast<const __m128i*>(texels));
+		const __m128i channelMask = _mm_set1_epi32(0xFF);
+		const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+		r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, channelMask)), scale);
+		g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 8), channelMask)), scale);
+		b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 16), channelMask)), scale);
+	}
+
+	float VirtualTexture::CalculateLod(const Vector2& dUVdx, const Vector2& dUVdy) const
+	{
+		// Footprint of one pixel in texels, the longest axis decides
+		const float width = static_cast<float>(GetWidth());
+		const float height = static_cast<float>(GetHeight());
+		const float lengthX = Square(dUVdx.x * width) + Square(dUVdx.y * height);
+		const float lengthY = Square(dUVdy.x * width) + Square(dUVdy.y * height);
+		const float maxLength = std::max(lengthX, lengthY);
+
+		if (maxLength <= 1.0f) {
+			return 0.0f;
+		}
+
+		// log2(sqrt(x)) = 0.5 * log2(x)
+		return 0.5f * std::log2(maxLength);
+	}
+
+	uint32_t VirtualTexture::GetPage(int level, int x, int y) const
+	{
+		const Level& mipLevel = m_Levels[level];
+		return mipLevel.firstPage + static_cast<uint32_t>((y / pageSize) * mipLevel.pagesWide + x / pageSize);
+	}
+
+	int32_t VirtualTexture::FindSlot(int level, int x, int y)
+	{
+		const uint32_t page = GetPage(level, x, y);
+		const int32_t slot = m_PageTable[page];
+		if (slot < 0 && !m_IsRequested[page])
+		{
+			m_IsRequested[page] = true;
+			m_Feedback.push_back(page);
+		}
+		return slot;
+	}
+
+	uint32_t VirtualTexture::FetchTexel(int level, int x, int y, int32_t fallbackSlot) const
+	{
+		const Level& mipLevel = m_Levels[level];
+		x = Wrap(x, mipLevel.width);
+		y = Wrap(y, mipLevel.height);
+
+		// A neighbour page that isn't resident yet clamps into the page that is
+		int32_t slot = m_PageTable[GetPage(level, x, y)];
+		if (slot < 0)
+		{
+			slot = fallbackSlot;
+			const int localPage = static_cast<int>(m_Slots[slot].page - mipLevel.firstPage);
+			const int pageX = (localPage % mipLevel.pagesWide) * pageSize;
+			const int pageY = (localPage / mipLevel.pagesWide) * pageSize;
+			x = std::clamp(x, pageX, pageX + pageSize - 1);
+			y = std::clamp(y, pageY, pageY + pageSize - 1);
+		}
+
+		return m_Slots[slot].texels[(x % pageSize) + (y % pageSize) * pageSize];
+	}
+
+	uint32_t VirtualTexture::SampleTexel(float u, float v, int level, SamplerFilter filter)
+	{
+		// Finest resident level at or above the wanted one, only the wanted page is requested
+		int residentLevel = level;
+		int32_t slot = -1;
+		while (true)
+		{
+			const Level& mipLevel = m_Levels[residentLevel];
+			const int x = Wrap(FloorToInt(u * mipLevel.width), mipLevel.width);
+			const int y = Wrap(FloorToInt(v * mipLevel.height), mipLevel.height);
+
+			slot = residentLevel == level ? FindSlot(residentLevel, x, y) : m_PageTable[GetPage(residentLevel, x, y)];
+			if (slot >= 0)
+			{
+				m_Slots[slot].lastUse = m_Frame;
+				if (filter == SamplerFilter::Point) {
+					return FetchTexel(residentLevel, x, y, slot);
+				}
+				break;
+			}
+
+			// The coarsest level is pinned, so this ends there
+			++residentLevel;
+		}
+
+		const Level& mipLevel = m_Levels[residentLevel];
+		const float x = u * mipLevel.width - 0.5f;
+		const float y = v * mipLevel.height - 0.5f;
+		const int x0 = FloorToInt(x);
+		const int y0 = FloorToInt(y);
+		const int fx = static_cast<int>((x - static_cast<float>(x0)) * 256.0f);
+		const int fy = static_cast<int>((y - static_cast<float>(y0)) * 256.0f);
+
+		const uint32_t texels[4]{
+			FetchTexel(residentLevel, x0, y0, slot),
+			FetchTexel(residentLevel, x0 + 1, y0, slot),
+			FetchTexel(residentLevel, x0, y0 + 1, slot),
+			FetchTexel(residentLevel, x0 + 1, y0 + 1, slot) };
+		return BlendBilinear(texels, fx, fy);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "Texture.h"
+#include <future>
+#include <mutex>
+
+namespace dae
+{
+	class ThreadPool;
+
+	// Texture split in 128x128 pages on disk, only the pages the software sampler touched are resident.
+	// Misses are recorded while sampling and loaded asynchronously in Update, until then a coarser level stands in.
+	class VirtualTexture final
+	{
+	public:
+		static constexpr int pageSize{ 128 };
+		static constexpr size_t defaultResidentPages{ 256 };	// 16 MB of RGBA8 pages
+		static constexpr int maxPagesInFlight{ 16 };
+
+		~VirtualTexture();
+
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture(VirtualTexture&&) noexcept = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(VirtualTexture&&) noexcept = delete;
+
+		// Offline step: writes the mip chain of an image as pages (the source has to fit in memory once)
+		static bool BuildPageFile(const std::string& imagePath, const std::string& pageFilePath);
+		// Only the coarsest level is read up front and stays resident
+		static VirtualTexture* Open(const std::string& pageFilePath, ThreadPool& loaderPool, size_t residentPageCount = defaultResidentPages);
+
+		// Same contract as Texture::Sample4, but records the missing pages (no blend between levels)
+		void Sample4(__m128 u, __m128 v, float lod, SamplerFilter filter, __m128& r, __m128& g, __m128& b);
+		float CalculateLod(const Vector2& dUVdx, const Vector2& dUVdy) const;
+
+		// Once per frame on the main thread: installs loaded pages and queues this frame's misses.
+		// Returns true when pages were installed, frames sampled before look different now
+		bool Update();
+
+		int GetWidth() const { return m_Levels.front().width; }
+		int GetHeight() const { return m_Levels.front().height; }
+
+	private:
+		struct Level
+		{
+			int width{};
+			int height{};
+			int pagesWide{};
+			int pagesHigh{};
+			uint32_t firstPage{};
+		};
+
+		// One resident page
+		struct Slot
+		{
+			std::vector<uint32_t> texels{};
+			uint32_t page{ invalidPage };
+			uint64_t lastUse{};
+			bool isPinned{ false };
+		};
+
+		struct LoadedPage
+		{
+			uint32_t page{};
+			std::vector<uint32_t> texels{};
+		};
+
+		static constexpr uint32_t invalidPage{ 0xFFFFFFFF };
+
+		std::string m_PageFilePath{};
+		size_t m_DataOffset{};
+		ThreadPool& m_LoaderPool;
+
+		// Level 0 is the full resolution, the last level fits in one page
+		std::vector<Level> m_Levels{};
+
+		// Global page id -> slot, -1 when not resident
+		std::vector<int32_t> m_PageTable{};
+		std::vector<Slot> m_Slots{};
+		uint64_t m_Frame{};
+
+		// Feedback: pages missed this frame, flagged so each is queued once until it arrives
+		std::vector<uint32_t> m_Feedback{};
+		std::vector<bool> m_IsRequested{};
+
+		// Filled in by the loader workers
+		std::vector<LoadedPage> m_LoadedPages{};
+		std::mutex m_LoadedMutex{};
+		std::vector<std::future<void>> m_Loads{};
+
+		VirtualTexture(const std::string& pageFilePath, ThreadPool& loaderPool);
+
+		bool ReadHeader(size_t residentPageCount);
+		bool ReadPage(uint32_t page, std::vector<uint32_t>& texels) const;
+		void Install(uint32_t page, std::vector<uint32_t>& texels, bool isPinned);
+
+		uint32_t GetPage(int level, int x, int y) const;
+		int32_t FindSlot(int level, int x, int y);
+		uint32_t FetchTexel(int level, int x, int y, int32_t fallbackSlot) const;
+		uint32_t SampleTexel(float u, float v, int level, SamplerFilter filter);
+	};
+}
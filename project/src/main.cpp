@@ -6,10 +6,33 @@
 
 #undef main
 #include "Renderer.h"
+#include "CameraPath.h"
+#include "FrameCapture.h"
+#include <cstring>
+#include <string>
 
 using namespace dae;
 
+// Command line of a headless run, see ParseHeadlessOptions
+struct HeadlessOptions
+{
+	bool isHeadless{ false };
+	int width{ 640 };
+	int height{ 480 };
+	int frameCount{ 60 };
+	float frameRate{ 60.f };
+	bool rotation{ true };
+	bool virtualTexturing{ false };
+	std::string cameraPathFile{};
+	// printf pattern with the frame number, e.g. frames/frame_%04d.png (.png or .bmp), empty renders without output
+	std::string outputPattern{};
+	// Asynchronous alternative to the output above, frames may be dropped (.png, .y4m or raw RGBA)
+	std::string capturePath{};
+};
+
 void TogglePrintFPS(bool& printFPS);
+bool ParseHeadlessOptions(int argc, char* args[], HeadlessOptions& options);
+int RunHeadless(const HeadlessOptions& options);
 
 void ShutDown(SDL_Window* pWindow)
 {
@@ -19,9 +42,11 @@ void ShutDown(SDL_Window* pWindow)
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	HeadlessOptions headlessOptions{};
+	if (!ParseHeadlessOptions(argc, args, headlessOptions))
+		return 1;
+	if (headlessOptions.isHeadless)
+		return RunHeadless(headlessOptions);
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -51,6 +76,10 @@ int main(int argc, char* args[])
 	while (isLooping)
 	{
 		//--------- Get input events ---------
+		// Nothing changed last frame: sleep until input arrives, the timeout picks up textures that finished loading
+		if (pRenderer->IsIdle())
+			SDL_WaitEventTimeout(nullptr, 50);
+
 		SDL_Event e;
 		while (SDL_PollEvent(&e))
 		{
@@ -59,6 +88,11 @@ int main(int argc, char* args[])
 			case SDL_QUIT:
 				isLooping = false;
 				break;
+			case SDL_WINDOWEVENT:
+				// The window contents may be gone, the last frame is drawn again
+				if (e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_RESTORED)
+					pRenderer->Invalidate();
+				break;
 			case SDL_KEYUP:
 				switch (e.key.keysym.scancode)
 				{
@@ -71,11 +105,11 @@ int main(int argc, char* args[])
 					pRenderer->ToggleVehicleRotation();
 					break;
 				case SDL_SCANCODE_F3:
-					// Toggle FireFX						(HARDWARE)		
+					// Toggle FireFX						(SHARED)
 					pRenderer->ToggleFireFX();
 					break;
 				case SDL_SCANCODE_F4:
-					// Cycle Sampler State					(HARDWARE)	
+					// Cycle Sampler State					(SHARED)	
 					pRenderer->ToggleTechnique();
 					break;
 				case SDL_SCANCODE_F5:
@@ -106,6 +140,30 @@ int main(int argc, char* args[])
 					// Toggle Print FPS						(SHARED)
 					TogglePrintFPS(PrintFPS);
 					break;
+				case SDL_SCANCODE_I:
+					// Toggle Fleet Instancing				(SHARED)
+					pRenderer->ToggleFleetInstancing();
+					break;
+				case SDL_SCANCODE_O:
+					// Toggle Order Independent Transparency	(SOFTWARE)
+					pRenderer->ToggleOrderIndependentTransparency();
+					break;
+				case SDL_SCANCODE_P:
+					// Cycle Present Latency				(SOFTWARE)
+					pRenderer->CyclePresentLatency();
+					break;
+				case SDL_SCANCODE_R:
+					// Toggle Dynamic Resolution			(SOFTWARE)
+					pRenderer->ToggleDynamicResolution();
+					break;
+				case SDL_SCANCODE_C:
+					// Toggle Frame Capture					(SOFTWARE)
+					pRenderer->ToggleFrameCapture();
+					break;
+				case SDL_SCANCODE_V:
+					// Toggle Virtual Texturing				(SOFTWARE)
+					pRenderer->ToggleVirtualTexturing();
+					break;
 				default:
 					break;
 				}
@@ -154,4 +212,138 @@ void TogglePrintFPS(bool& printFPS)
 		std::cout << "OFF \n";
 	}
 	std::cout << "\033[0m";
-}
\ No newline at end of file
+}
+bool ParseHeadlessOptions(int argc, char* args[], HeadlessOptions& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue{ i + 1 < argc };
+		if (std::strcmp(args[i], "--headless") == 0)
+		{
+			options.isHeadless = true;
+		}
+		else if (std::strcmp(args[i], "--resolution") == 0 && hasValue)
+		{
+			if (std::sscanf(args[++i], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0)
+			{
+				std::cout << "Invalid resolution, expected WIDTHxHEIGHT\n";
+				return false;
+			}
+		}
+		else if (std::strcmp(args[i], "--frames") == 0 && hasValue)
+		{
+			options.frameCount = std::max(1, std::atoi(args[++i]));
+		}
+		else if (std::strcmp(args[i], "--fps") == 0 && hasValue)
+		{
+			options.frameRate = std::max(1.f, static_cast<float>(std::atof(args[++i])));
+		}
+		else if (std::strcmp(args[i], "--camera-path") == 0 && hasValue)
+		{
+			options.cameraPathFile = args[++i];
+		}
+		else if (std::strcmp(args[i], "--output") == 0 && hasValue)
+		{
+			// Goes to snprintf, and one file per frame needs the frame number in it
+			options.outputPattern = args[++i];
+			if (!FrameCapture::IsFrameNumberPattern(options.outputPattern))
+			{
+				std::cout << "Invalid output pattern, expected exactly one %d or %0Nd for the frame number\n";
+				return false;
+			}
+		}
+		else if (std::strcmp(args[i], "--capture") == 0 && hasValue)
+		{
+			options.capturePath = args[++i];
+		}
+		else if (std::strcmp(args[i], "--virtual-texture") == 0)
+		{
+			options.virtualTexturing = true;
+		}
+		else if (std::strcmp(args[i], "--no-rotation") == 0)
+		{
+			options.rotation = false;
+		}
+		else
+		{
+			std::cout << "Unknown option " << args[i] << "\n"
+				<< "Usage: [--headless] [--resolution WIDTHxHEIGHT] [--frames N] [--fps N] [--camera-path FILE] [--output PATTERN] [--capture PATH] [--virtual-texture] [--no-rotation]\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+int RunHeadless(const HeadlessOptions& options)
+{
+	// No video subsystem, nothing here needs a display
+	SDL_Init(0);
+
+	CameraPath cameraPath{};
+	if (!options.cameraPathFile.empty() && !cameraPath.LoadFromFile(options.cameraPathFile))
+	{
+		std::cout << "Could not read camera path " << options.cameraPathFile << "\n";
+		SDL_Quit();
+		return 1;
+	}
+
+	const auto pRenderer = new Renderer(options.width, options.height);
+	if (!pRenderer->IsInitialized())
+	{
+		delete pRenderer;
+		SDL_Quit();
+		return 1;
+	}
+
+	if (!options.rotation)
+		pRenderer->ToggleVehicleRotation();
+	if (options.virtualTexturing)
+		pRenderer->ToggleVirtualTexturing();
+
+	// Batch frames have to be final, not the placeholder
+	pRenderer->WaitForPendingTextures();
+
+	if (!options.capturePath.empty())
+		pRenderer->StartCapture(options.capturePath, options.frameRate);
+
+	// Fixed time step, the output does not depend on how fast frames render
+	const float frameTime{ 1.f / options.frameRate };
+	const bool isPng{ options.outputPattern.ends_with(".png") };
+	std::vector<char> fileName(options.outputPattern.size() + 32);
+	uint64_t renderCounts{};
+
+	for (int frame = 0; frame < options.frameCount; ++frame)
+	{
+		if (!cameraPath.IsEmpty())
+		{
+			const float t{ options.frameCount > 1 ? static_cast<float>(frame) / (options.frameCount - 1) : 0.f };
+			const CameraPath::Keyframe pose{ cameraPath.Evaluate(t) };
+			pRenderer->SetCameraPose(pose.origin, pose.yaw, pose.pitch);
+		}
+
+		// Every frame is written, even when it did not change
+		pRenderer->Invalidate();
+		const uint64_t start{ SDL_GetPerformanceCounter() };
+		pRenderer->Update(frameTime);
+		pRenderer->Render();
+		renderCounts += SDL_GetPerformanceCounter() - start;
+
+		if (options.outputPattern.empty())
+			continue;
+
+		std::snprintf(fileName.data(), fileName.size(), options.outputPattern.c_str(), frame);
+		const int saved{ isPng ? IMG_SavePNG(pRenderer->GetFrame(), fileName.data()) : SDL_SaveBMP(pRenderer->GetFrame(), fileName.data()) };
+		if (saved != 0)
+			std::cout << "Could not write " << fileName.data() << ": " << SDL_GetError() << "\n";
+	}
+
+	// For the performance jobs, file output excluded
+	const double renderSeconds{ static_cast<double>(renderCounts) / SDL_GetPerformanceFrequency() };
+	std::cout << "Rendered " << options.frameCount << " frames at " << options.width << "x" << options.height
+		<< ", average " << renderSeconds * 1000.0 / options.frameCount << " ms per frame\n";
+
+	pRenderer->StopCapture();
+	delete pRenderer;
+	SDL_Quit();
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <sstream>
 #include <memory>
+#include <immintrin.h> // SSE intrinsics for the software rasterizer
 #define NOMINMAX  //for directx
 
 // SDL Headers